@@ -0,0 +1,192 @@
+#include "ASTNodeIndex.hh"
+
+#include "clang/AST/RecursiveASTVisitor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace cpp2c
+{
+    static std::pair<unsigned, unsigned> fileRangeKey(
+        clang::SourceLocation B, clang::SourceLocation E)
+    {
+        return {B.getRawEncoding(), E.getRawEncoding()};
+    }
+
+    // Visits the AST in the same order as a MatchFinder, recording each
+    // node's locations in the index
+    class ASTNodeIndexBuilder
+        : public clang::RecursiveASTVisitor<ASTNodeIndexBuilder>
+    {
+        using Base = clang::RecursiveASTVisitor<ASTNodeIndexBuilder>;
+
+    public:
+        clang::SourceManager &SM;
+        ASTNodeIndex &Index;
+
+        ASTNodeIndexBuilder(clang::SourceManager &SM, ASTNodeIndex &Index)
+            : SM(SM), Index(Index) {}
+
+        bool shouldVisitTemplateInstantiations() const { return true; }
+        bool shouldVisitImplicitCode() const { return true; }
+
+        template <typename NodeT>
+        bool record(const NodeT &Node, DeclStmtTypeLoc DSTL,
+                    ASTNodeIndex::NodeTable &Table)
+        {
+            // None of the queries can match a node with an invalid location
+            if (Node.getBeginLoc().isInvalid() || Node.getEndLoc().isInvalid())
+                return false;
+
+            Table.Entries.push_back({DSTL,
+                                     SM.getExpansionLoc(Node.getEndLoc()),
+                                     SM.getFileLoc(Node.getBeginLoc()),
+                                     SM.getFileLoc(Node.getEndLoc())});
+            return true;
+        }
+
+        bool TraverseStmt(clang::Stmt *S)
+        {
+            if (!S)
+                return true;
+            if (!(clang::isa<clang::ImplicitCastExpr>(S) ||
+                  clang::isa<clang::ImplicitValueInitExpr>(S)))
+                record(*S, S, Index.Stmts);
+            return Base::TraverseStmt(S);
+        }
+
+        bool TraverseDecl(clang::Decl *D)
+        {
+            if (!D)
+                return true;
+            record(*D, D, Index.Decls);
+            return Base::TraverseDecl(D);
+        }
+
+        bool TraverseTypeLoc(clang::TypeLoc TL)
+        {
+            if (TL.isNull())
+                return true;
+            Index.TypeLocStorage.push_back(TL);
+            if (!record(TL, &Index.TypeLocStorage.back(), Index.TypeLocs))
+                Index.TypeLocStorage.pop_back();
+            return Base::TraverseTypeLoc(TL);
+        }
+    };
+
+    ASTNodeIndex::ASTNodeIndex(clang::ASTContext &Ctx)
+        : ASTNodeIndex(Ctx, {Ctx.getTranslationUnitDecl()}) {}
+
+    ASTNodeIndex::ASTNodeIndex(clang::ASTContext &Ctx,
+                               llvm::ArrayRef<clang::Decl *> Scope)
+    {
+        auto &SM = Ctx.getSourceManager();
+        ASTNodeIndexBuilder Builder(SM, *this);
+        for (auto D : Scope)
+        {
+            Builder.TraverseDecl(D);
+
+            if (clang::isa<clang::TranslationUnitDecl>(D))
+            {
+                IndexesEntireTU = true;
+                continue;
+            }
+            // Only ranges that begin and end in the same file can be
+            // compared by their raw encodings
+            auto B = SM.getFileLoc(D->getBeginLoc());
+            auto E = SM.getFileLoc(D->getEndLoc());
+            if (B.isValid() && E.isValid() &&
+                SM.getFileID(B) == SM.getFileID(E))
+                ScopeRanges.emplace_back(B, E);
+        }
+
+        std::sort(ScopeRanges.begin(), ScopeRanges.end(),
+                  [](clang::SourceRange L, clang::SourceRange R)
+                  { return L.getBegin() < R.getBegin(); });
+        for (auto R : ScopeRanges)
+            ScopeRangeMaxEnds.push_back(
+                ScopeRangeMaxEnds.empty()
+                    ? R.getEnd()
+                    : std::max(ScopeRangeMaxEnds.back(), R.getEnd()));
+
+        Stmts.finalize();
+        Decls.finalize();
+        TypeLocs.finalize();
+    }
+
+    void ASTNodeIndex::NodeTable::finalize()
+    {
+        ByExpansionEnd.resize(Entries.size());
+        for (unsigned I = 0; I < Entries.size(); I++)
+            ByExpansionEnd[I] = I;
+
+        std::stable_sort(ByExpansionEnd.begin(), ByExpansionEnd.end(),
+                         [this](unsigned L, unsigned R)
+                         { return Entries[L].ExpansionEnd <
+                                  Entries[R].ExpansionEnd; });
+
+        for (unsigned I = 0; I < Entries.size(); I++)
+            ByFileRange[fileRangeKey(Entries[I].FileBegin,
+                                     Entries[I].FileEnd)]
+                .push_back(I);
+    }
+
+    std::vector<const ASTNodeIndex::Entry *>
+    ASTNodeIndex::NodeTable::inVisitOrder(
+        std::vector<unsigned>::const_iterator Begin,
+        std::vector<unsigned>::const_iterator End) const
+    {
+        std::vector<unsigned> Indices(Begin, End);
+        std::sort(Indices.begin(), Indices.end());
+        std::vector<const Entry *> Result;
+        Result.reserve(Indices.size());
+        for (auto I : Indices)
+            Result.push_back(&Entries[I]);
+        return Result;
+    }
+
+    std::vector<const ASTNodeIndex::Entry *>
+    ASTNodeIndex::NodeTable::expansionEndsWithin(
+        clang::SourceRange Range) const
+    {
+        auto Begin = std::lower_bound(
+            ByExpansionEnd.begin(), ByExpansionEnd.end(), Range.getBegin(),
+            [this](unsigned I, clang::SourceLocation L)
+            { return Entries[I].ExpansionEnd < L; });
+        auto End = std::upper_bound(
+            Begin, ByExpansionEnd.end(), Range.getEnd(),
+            [this](clang::SourceLocation L, unsigned I)
+            { return L < Entries[I].ExpansionEnd; });
+        return inVisitOrder(Begin, End);
+    }
+
+    std::vector<const ASTNodeIndex::Entry *>
+    ASTNodeIndex::NodeTable::withFileRange(clang::SourceRange Range) const
+    {
+        std::vector<const Entry *> Result;
+        auto It = ByFileRange.find(
+            fileRangeKey(Range.getBegin(), Range.getEnd()));
+        if (It != ByFileRange.end())
+            for (auto I : It->second)
+                Result.push_back(&Entries[I]);
+        return Result;
+    }
+
+    bool ASTNodeIndex::covers(clang::SourceRange FileRange) const
+    {
+        if (IndexesEntireTU)
+            return true;
+
+        // File regions do not overlap in the source location address
+        // space, so if a range that begins and ends in a single file
+        // contains both ends of the given range, then so does that file
+        auto It = std::upper_bound(
+            ScopeRanges.begin(), ScopeRanges.end(), FileRange.getBegin(),
+            [](clang::SourceLocation L, clang::SourceRange R)
+            { return L < R.getBegin(); });
+        if (It == ScopeRanges.begin())
+            return false;
+        auto MaxEnd = ScopeRangeMaxEnds[It - ScopeRanges.begin() - 1];
+        return !(MaxEnd < FileRange.getEnd());
+    }
+} // namespace cpp2c
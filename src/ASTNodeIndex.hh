@@ -0,0 +1,108 @@
+#pragma once
+
+#include "DeclStmtTypeLoc.hh"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/SourceLocation.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace cpp2c
+{
+    // An index of the source locations of every Stmt, Decl, and TypeLoc in
+    // a translation unit, sorted so that the nodes in a given range can be
+    // found with a binary search instead of a traversal of the whole AST.
+    // Nodes are recorded in the same order that a MatchFinder visits them,
+    // and queries return nodes in that order, so that results match those of
+    // running a matcher over the AST.
+    class ASTNodeIndex
+    {
+    public:
+        struct Entry
+        {
+            DeclStmtTypeLoc Node;
+            // The expansion location of the end of the node
+            clang::SourceLocation ExpansionEnd;
+            // The file locations of the beginning and end of the node
+            clang::SourceLocation FileBegin;
+            clang::SourceLocation FileEnd;
+        };
+
+        // The indexed nodes of a single kind
+        class NodeTable
+        {
+        public:
+            // The nodes of this kind in the order they were visited
+            std::vector<Entry> Entries;
+
+            // Returns the nodes whose expansion end lies within the
+            // given range, in the order they were visited
+            std::vector<const Entry *> expansionEndsWithin(
+                clang::SourceRange Range) const;
+
+            // Returns the nodes whose file locations begin and end at
+            // exactly the given range, in the order they were visited
+            std::vector<const Entry *> withFileRange(
+                clang::SourceRange Range) const;
+
+            // Sorts the lookup tables once all entries have been added
+            void finalize();
+
+        private:
+            // Indices into Entries sorted by expansion end location
+            std::vector<unsigned> ByExpansionEnd;
+            // Indices into Entries keyed by the raw encodings of their
+            // file begin and end locations, in visit order
+            llvm::DenseMap<std::pair<unsigned, unsigned>,
+                           llvm::SmallVector<unsigned, 1>>
+                ByFileRange;
+
+            std::vector<const Entry *> inVisitOrder(
+                std::vector<unsigned>::const_iterator Begin,
+                std::vector<unsigned>::const_iterator End) const;
+        };
+
+        // Stmts do not include implicit casts or implicit value
+        // initializations, since no alignment query considers them
+        NodeTable Stmts;
+        NodeTable Decls;
+        NodeTable TypeLocs;
+
+        // Indexes all nodes in the given AST context
+        ASTNodeIndex(clang::ASTContext &Ctx);
+
+        // Indexes only the given declarations and their descendants.
+        // The declarations must be given in the order they appear in the
+        // translation unit.
+        ASTNodeIndex(clang::ASTContext &Ctx,
+                     llvm::ArrayRef<clang::Decl *> Scope);
+
+        // Returns true if the index contains every node that lies within
+        // the given file range, i.e., if the whole translation unit was
+        // indexed or the range lies within one of the indexed declarations
+        bool covers(clang::SourceRange FileRange) const;
+
+        // Entries point into this index, so it must not be copied
+        ASTNodeIndex(const ASTNodeIndex &) = delete;
+        ASTNodeIndex &operator=(const ASTNodeIndex &) = delete;
+
+    private:
+        // Stable storage for the indexed TypeLocs, since the AST only
+        // provides them by value
+        std::deque<clang::TypeLoc> TypeLocStorage;
+
+        bool IndexesEntireTU = false;
+        // The file ranges of the indexed declarations sorted by their
+        // beginning, and the furthest end of any range up to each one
+        std::vector<clang::SourceRange> ScopeRanges;
+        std::vector<clang::SourceLocation> ScopeRangeMaxEnds;
+
+        friend class ASTNodeIndexBuilder;
+    };
+} // namespace cpp2c
@@ -1,5 +1,9 @@
 #include "ASTUtils.hh"
 
+#include "clang/AST/DeclCXX.h"
+
+#include <algorithm>
+
 namespace cpp2c
 {
     bool isInTree(
@@ -18,4 +22,99 @@ namespace cpp2c
 
         return false;
     }
+
+    bool isInTree(
+        const clang::Stmt *ST,
+        std::function<bool(const clang::Stmt *)> pred,
+        const cpp2c::StmtNumbering &Numbering)
+    {
+        if (!Numbering.hasContiguousSubtree(ST))
+            return isInTree(ST, pred);
+
+        auto Subtree = Numbering.subtreeOf(ST);
+        return std::any_of(Subtree.begin(), Subtree.end(), pred);
+    }
+
+    std::vector<clang::Decl *> findTopLevelDeclsIntersecting(
+        const std::vector<clang::SourceRange> &Ranges,
+        clang::ASTContext &Ctx)
+    {
+        auto &SM = Ctx.getSourceManager();
+
+        // Collect the declarations a traversal of the translation unit
+        // would visit directly, along with their expansion ranges
+        std::vector<clang::Decl *> Decls;
+        std::vector<clang::SourceRange> DeclRanges;
+        for (auto D : Ctx.getTranslationUnitDecl()->decls())
+        {
+            if (llvm::isa<clang::BlockDecl>(D) ||
+                llvm::isa<clang::CapturedDecl>(D))
+                continue;
+            if (auto RD = llvm::dyn_cast<clang::CXXRecordDecl>(D))
+                if (RD->isLambda())
+                    continue;
+            if (D->getBeginLoc().isInvalid() || D->getEndLoc().isInvalid())
+                continue;
+            Decls.push_back(D);
+            DeclRanges.push_back({SM.getExpansionLoc(D->getBeginLoc()),
+                                  SM.getExpansionLoc(D->getEndLoc())});
+        }
+
+        // Sort declarations by where they begin, and record the furthest
+        // end among each prefix of that order
+        std::vector<unsigned> ByBegin(Decls.size());
+        for (unsigned I = 0; I < Decls.size(); I++)
+            ByBegin[I] = I;
+        std::stable_sort(ByBegin.begin(), ByBegin.end(),
+                         [&](unsigned L, unsigned R)
+                         { return DeclRanges[L].getBegin() <
+                                  DeclRanges[R].getBegin(); });
+        std::vector<clang::SourceLocation> MaxEnd;
+        for (auto I : ByBegin)
+            MaxEnd.push_back(MaxEnd.empty() ||
+                                     MaxEnd.back() < DeclRanges[I].getEnd()
+                                 ? DeclRanges[I].getEnd()
+                                 : MaxEnd.back());
+
+        std::vector<bool> Selected(Decls.size(), false);
+        auto SelectIntersecting = [&](clang::SourceLocation B,
+                                      clang::SourceLocation E)
+        {
+            auto It = std::upper_bound(
+                ByBegin.begin(), ByBegin.end(), E,
+                [&](clang::SourceLocation L, unsigned I)
+                { return L < DeclRanges[I].getBegin(); });
+            for (auto K = It - ByBegin.begin(); K > 0; K--)
+            {
+                if (MaxEnd[K - 1] < B)
+                    break;
+                if (!(DeclRanges[ByBegin[K - 1]].getEnd() < B))
+                    Selected[ByBegin[K - 1]] = true;
+            }
+        };
+
+        for (auto &&R : Ranges)
+        {
+            auto B = R.getBegin(), E = R.getEnd();
+            if (B.isInvalid() || E.isInvalid())
+                continue;
+            SelectIntersecting(B, E);
+
+            // Also select the declarations enclosing the #include
+            // directives that the range was included through
+            auto IncludeLoc = SM.getIncludeLoc(SM.getFileID(B));
+            while (IncludeLoc.isValid())
+            {
+                IncludeLoc = SM.getExpansionLoc(IncludeLoc);
+                SelectIntersecting(IncludeLoc, IncludeLoc);
+                IncludeLoc = SM.getIncludeLoc(SM.getFileID(IncludeLoc));
+            }
+        }
+
+        std::vector<clang::Decl *> Result;
+        for (unsigned I = 0; I < Decls.size(); I++)
+            if (Selected[I])
+                Result.push_back(Decls[I]);
+        return Result;
+    }
 } // namespace cpp2c
@@ -1,12 +1,33 @@
 #pragma once
 
+#include "StmtNumbering.hh"
+
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Stmt.h"
+#include "clang/Basic/SourceLocation.h"
 
 #include <functional>
+#include <vector>
 
 namespace cpp2c
 {
     bool isInTree(
         const clang::Stmt *ST,
         std::function<bool(const clang::Stmt *)> pred);
+
+    // Same as above, but uses the given numbering to check the Stmts under
+    // ST without a traversal
+    bool isInTree(
+        const clang::Stmt *ST,
+        std::function<bool(const clang::Stmt *)> pred,
+        const cpp2c::StmtNumbering &Numbering);
+
+    // Returns the declarations at translation unit scope whose expansion
+    // ranges intersect any of the given file ranges, in the order they
+    // appear in the translation unit.
+    // A range in an included file intersects the declarations that its
+    // #include directives appear in.
+    std::vector<clang::Decl *> findTopLevelDeclsIntersecting(
+        const std::vector<clang::SourceRange> &Ranges,
+        clang::ASTContext &Ctx);
 } // namespace cpp2c
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "DeclStmtTypeLoc.hh"
+#include "ExpansionLocTable.hh"
+#include "SourceLocationCache.hh"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Stmt.h"
+#include "clang/AST/TypeLoc.h"
+
+#include "llvm/ADT/DenseSet.h"
+
+namespace cpp2c
+{
+    // The nodes that alignment queries have already matched, so that they
+    // do not match the subtrees of those nodes as well
+    struct ClaimedNodes
+    {
+        llvm::DenseSet<const clang::Stmt *> Stmts; // Also includes Exprs, can be casted
+        llvm::DenseSet<const clang::Decl *> Decls;
+        llvm::DenseSet<const clang::TypeLoc *> TypeLocs;
+    };
+
+    // The state shared by a sequence of alignment queries over a single
+    // translation unit.
+    // Queries for Stmts, Decls, and TypeLocs each keep track of the nodes
+    // they have claimed separately.
+    // Contexts that do not share a location cache are independent of one
+    // another, so they may be used for separate translation units or from
+    // separate threads.
+    class AlignmentContext
+    {
+    public:
+        clang::ASTContext &Ctx;
+        // The decomposed node locations the matchers look up; this may be
+        // shared by the contexts for a single translation unit
+        SourceLocationCache &Locations;
+        ClaimedNodes ClaimedByStmtQueries;
+        ClaimedNodes ClaimedByDeclQueries;
+        ClaimedNodes ClaimedByTypeLocQueries;
+
+        // If set, then body alignment does not look for aligned Decls and
+        // TypeLocs when the aligned Stmts already rule them out
+        bool Tiered = false;
+        // The number of expansions tiered alignment aligned from Stmts
+        // alone, and the number for which it also had to look for Decls
+        // and TypeLocs
+        unsigned AlignedByStmtTier = 0;
+        unsigned AlignedByAllTiers = 0;
+
+        // If set, then nodes that begin or end with tokens from outside of
+        // an expansion's tree are ruled out without checking their
+        // locations in detail
+        const ExpansionLocTable *ExpansionLocs = nullptr;
+
+        AlignmentContext(clang::ASTContext &Ctx,
+                         SourceLocationCache &Locations)
+            : Ctx(Ctx), Locations(Locations) {}
+
+        // Returns the nodes claimed by queries for the given node's kind
+        ClaimedNodes &claimedBy(const clang::Stmt &)
+        {
+            return ClaimedByStmtQueries;
+        }
+        ClaimedNodes &claimedBy(const clang::Decl &)
+        {
+            return ClaimedByDeclQueries;
+        }
+        ClaimedNodes &claimedBy(const clang::TypeLoc &)
+        {
+            return ClaimedByTypeLocQueries;
+        }
+        ClaimedNodes &claimedBy(DeclStmtTypeLoc DSTL)
+        {
+            return DSTL.ST  ? claimedBy(*DSTL.ST)
+                   : DSTL.D ? claimedBy(*DSTL.D)
+                            : claimedBy(*DSTL.TL);
+        }
+    };
+} // namespace cpp2c
@@ -1,13 +1,63 @@
 #include "AlignmentMatchers.hh"
 #include "ExpansionMatchHandler.hh"
+#include "Parallel.hh"
+
+#include <mutex>
 
 namespace cpp2c
 {
+    // Calls Warm with each index in [0, N) and the context's location cache
+    // on the current thread, and then calls F with each index and the
+    // location cache to check its candidates with.
+    // Warm should make any other SourceManager queries that F needs, and
+    // warm up the context's cache with the locations F is likely to look up.
+    // With a thread pool, the context's cache is only read while F runs,
+    // and each call gets a small cache of its own on top of it, which
+    // decomposes the locations it misses under a lock. Its counts are added
+    // to the context's once the call finishes.
+    template <typename WarmFn, typename Fn>
+    static void parallelForWithLocations(llvm::ThreadPool *Pool,
+                                         unsigned N,
+                                         cpp2c::AlignmentContext &Context,
+                                         WarmFn Warm,
+                                         Fn F)
+    {
+        for (unsigned I = 0; I < N; I++)
+            Warm(I, Context.Locations);
+
+        if (!Pool)
+        {
+            parallelFor(nullptr, N, [&](unsigned I)
+                        { F(I, Context.Locations); });
+            return;
+        }
+
+        std::mutex SourceManagerMutex, CountsMutex;
+        parallelFor(
+            Pool, N,
+            [&](unsigned I)
+            {
+                SourceLocationCache Locs(Context.Locations,
+                                         SourceManagerMutex);
+                F(I, Locs);
+                std::lock_guard<std::mutex> Lock(CountsMutex);
+                Context.Locations.addCounts(Locs);
+            });
+    }
+
+    // Warms up the given cache with the locations the matchers look up for
+    // a node with the given begin and end locations
+    static void prewarmNode(SourceLocationCache &Locs, DeclStmtTypeLoc Node)
+    {
+        auto Range = Node.ST  ? Node.ST->getSourceRange()
+                     : Node.D ? Node.D->getSourceRange()
+                              : Node.TL->getSourceRange();
+        Locs.prewarm(Range.getBegin());
+        Locs.prewarm(Range.getEnd());
+    }
 
     void storeChildren(cpp2c::DeclStmtTypeLoc DSTL,
-                       std::set<const clang::Stmt *> &MatchedStmts,
-                       std::set<const clang::Decl *> &MatchedDecls,
-                       std::set<const clang::TypeLoc *> &MatchedTypeLocs)
+                       cpp2c::ClaimedNodes &Claimed)
     {
         if (DSTL.ST)
         {
@@ -22,7 +72,7 @@ namespace cpp2c
 
                 // llvm::errs() << "Inserting:\n";
                 // Cur->dumpColor();
-                MatchedStmts.insert(Cur);
+                Claimed.Stmts.insert(Cur);
                 for (auto &&child : Cur->children())
                     if (child)
                         Descendants.push(child);
@@ -32,7 +82,7 @@ namespace cpp2c
         {
             // llvm::errs() << "Inserting:\n";
             // DSTL.D->dump();
-            MatchedDecls.insert(DSTL.D);
+            Claimed.Decls.insert(DSTL.D);
         }
         // else if (DSTL.TL)
         // {
@@ -46,14 +96,297 @@ namespace cpp2c
         //     else
         //         llvm::errs() << "<Null type>\n";
         // }
-        //     MatchedTypeLocs.insert(DSTL.TL);
+        //     Claimed.TypeLocs.insert(DSTL.TL);
         // }
     }
 
-     void findAlignedASTNodesForExpansion(
+    bool claimAlignedNode(cpp2c::DeclStmtTypeLoc DSTL,
+                          clang::ASTContext *Ctx,
+                          cpp2c::ClaimedNodes &Claimed,
+                          bool CheckParents)
+    {
+        static const constexpr bool debug = false;
+
+        // Check that this node has not been matched before
+        bool foundNodeBefore = false;
+        if (DSTL.ST && Claimed.Stmts.count(DSTL.ST))
+            foundNodeBefore = true;
+        else if (DSTL.D && Claimed.Decls.count(DSTL.D))
+            foundNodeBefore = true;
+        else if (DSTL.TL &&
+                 Claimed.TypeLocs.count(DSTL.TL))
+            foundNodeBefore = true;
+        if (foundNodeBefore)
+        {
+            if (debug)
+            {
+                llvm::errs() << "Found node before\n";
+                DSTL.dump();
+            }
+            return false;
+        }
+
+        // Check that this node is not a proper subtree of an aligned node
+        // that we already found.
+        if (CheckParents)
+        {
+            bool foundParentBefore = false;
+            auto Parents = DSTL.ST  ? Ctx->getParents(*DSTL.ST)
+                           : DSTL.D ? Ctx->getParents(*DSTL.D)
+                                    : Ctx->getParents(*DSTL.TL);
+            for (auto P : Parents)
+            {
+                if (auto PST = P.get<clang::Stmt>())
+                {
+                    if (Claimed.Stmts.count(PST))
+                        foundParentBefore = true;
+                }
+                else if (auto DP = P.get<clang::Decl>())
+                {
+                    if (Claimed.Decls.count(DP))
+                        foundParentBefore = true;
+                }
+                else if (auto DTL = P.get<clang::TypeLoc>())
+                {
+                    if (Claimed.TypeLocs.count(DTL))
+                        foundParentBefore = true;
+                }
+            }
+            if (foundParentBefore)
+            {
+                if (debug)
+                {
+                    llvm::errs() << "Found parent before\n";
+                }
+                return false;
+            }
+        }
+
+        // Store this node and its children in the set of aligned subtrees
+        // we've found
+        storeChildren(DSTL, Claimed);
+        return true;
+    }
+
+    bool rulesOutDeclAndTypeLocAlignment(const clang::Stmt *ST)
+    {
+        return clang::isa_and_nonnull<clang::Expr>(ST) &&
+               !clang::isa<clang::LambdaExpr>(ST) &&
+               !clang::isa<clang::BlockExpr>(ST);
+    }
+
+    void findAlignedASTNodesForExpansions(
+        std::vector<cpp2c::MacroExpansionNode *> &Expansions,
+        cpp2c::AlignmentContext &Context,
+        const cpp2c::ASTNodeIndex &Index,
+        llvm::ThreadPool *Pool)
+    {
+        auto &Ctx = Context.Ctx;
+
+        // Whether a node's locations align with an expansion does not depend
+        // on which nodes have been claimed, so find each expansion's
+        // candidates first, and only then claim them in order.
+        // Queries for Stmts, Decls, and TypeLocs claim nodes separately, so
+        // every expansion's Stmts can be claimed before any Decls and
+        // TypeLocs are looked for, and tiered alignment can then skip them
+        // for the expansions whose claimed Stmts rule them out, as the
+        // matchers do.
+        auto CollectCandidates =
+            [&](unsigned I, SourceLocationCache &Locs,
+                const ASTNodeIndex::NodeTable &Table,
+                std::vector<const ASTNodeIndex::Entry *> &MayAlign)
+        {
+            // The nodes whose expansion end lies within the expansion's
+            // spelling range, and that the expansion location table does
+            // not rule out
+            auto Exp = Expansions[I];
+            for (auto E : Table.expansionEndsWithin(Exp->SpellingRange))
+            {
+                auto &N = E->Node;
+                if (N.ST  ? mayAlignWithExpansion(*N.ST, Context, Exp)
+                    : N.D ? mayAlignWithExpansion(*N.D, Context, Exp)
+                          : mayAlignWithExpansion(*N.TL, Context, Exp))
+                {
+                    MayAlign.push_back(E);
+                    prewarmNode(Locs, N);
+                }
+            }
+        };
+        auto Claim = [&](MacroExpansionNode *Exp,
+                         const std::vector<const ASTNodeIndex::Entry *> &Candidates)
+        {
+            for (auto E : Candidates)
+                if (claimAlignedNode(E->Node, &Ctx,
+                                     Context.claimedBy(E->Node)))
+                    Exp->ASTRoots.push_back(E->Node);
+        };
+
+        // Align Stmts first
+        std::vector<std::vector<const ASTNodeIndex::Entry *>>
+            MayAlignStmts(Expansions.size()),
+            StmtCandidates(Expansions.size());
+        parallelForWithLocations(
+            Pool, Expansions.size(), Context,
+            [&](unsigned I, SourceLocationCache &Locs)
+            {
+                CollectCandidates(I, Locs, Index.Stmts, MayAlignStmts[I]);
+
+                auto Exp = Expansions[I];
+                if (auto Arg = Exp->ArgDefBeginsWith)
+                    if (!Arg->Tokens.empty())
+                        Locs.prewarm(Arg->Tokens.front().getLocation());
+                if (auto Arg = Exp->ArgDefEndsWith)
+                    if (!Arg->Tokens.empty())
+                        Locs.prewarm(Arg->Tokens.back().getLocation());
+            },
+            [&](unsigned I, SourceLocationCache &Locs)
+            {
+                auto Exp = Expansions[I];
+                for (auto E : MayAlignStmts[I])
+                    if (isAlignedWithExpansion(*E->Node.ST, Locs, Exp))
+                        StmtCandidates[I].push_back(E);
+            });
+
+        // Claim the Stmts in the same order the matchers would, and find
+        // the expansions that still need Decls and TypeLocs
+        std::vector<unsigned> NeedAllTiers;
+        for (unsigned I = 0; I < Expansions.size(); I++)
+        {
+            auto Exp = Expansions[I];
+            Claim(Exp, StmtCandidates[I]);
+
+            if (Context.Tiered && Exp->ASTRoots.size() == 1 &&
+                rulesOutDeclAndTypeLocAlignment(Exp->ASTRoots.front().ST))
+            {
+                Context.AlignedByStmtTier++;
+                continue;
+            }
+            if (Context.Tiered)
+                Context.AlignedByAllTiers++;
+            NeedAllTiers.push_back(I);
+        }
+
+        // Then align Decls and TypeLocs with the remaining expansions
+        std::vector<std::vector<const ASTNodeIndex::Entry *>>
+            MayAlignDecls(NeedAllTiers.size()),
+            MayAlignTypeLocs(NeedAllTiers.size()),
+            Candidates(NeedAllTiers.size());
+        parallelForWithLocations(
+            Pool, NeedAllTiers.size(), Context,
+            [&](unsigned J, SourceLocationCache &Locs)
+            {
+                CollectCandidates(NeedAllTiers[J], Locs,
+                                  Index.Decls, MayAlignDecls[J]);
+                CollectCandidates(NeedAllTiers[J], Locs,
+                                  Index.TypeLocs, MayAlignTypeLocs[J]);
+            },
+            [&](unsigned J, SourceLocationCache &Locs)
+            {
+                auto Exp = Expansions[NeedAllTiers[J]];
+                for (auto E : MayAlignDecls[J])
+                    if (isAlignedWithExpansion(*E->Node.D, Locs, Exp))
+                        Candidates[J].push_back(E);
+
+                for (auto E : MayAlignTypeLocs[J])
+                    if (isAlignedWithExpansion(*E->Node.TL, Locs, Exp))
+                        Candidates[J].push_back(E);
+            });
+        for (unsigned J = 0; J < NeedAllTiers.size(); J++)
+            Claim(Expansions[NeedAllTiers[J]], Candidates[J]);
+
+        // If an expansion only aligns with one node, then set this as its
+        // aligned root
+        for (auto Exp : Expansions)
+            Exp->AlignedRoot = (Exp->ASTRoots.size() == 1)
+                                   ? (&(Exp->ASTRoots.front()))
+                                   : nullptr;
+    }
+
+    void findAlignedASTNodesForArguments(
+        std::vector<cpp2c::MacroExpansionNode *> &Expansions,
+        cpp2c::AlignmentContext &Context,
+        const cpp2c::ASTNodeIndex &Index,
+        llvm::ThreadPool *Pool)
+    {
+        auto &Ctx = Context.Ctx;
+        auto &SM = Ctx.getSourceManager();
+
+        // Only nodes that begin and end at the same file locations as an
+        // argument's first and last tokens can be spelled from it, so
+        // collect the file range of every argument
+        std::vector<cpp2c::MacroExpansionArgument *> Args;
+        std::vector<clang::SourceRange> ArgRanges;
+        // Whether the nodes spelled from each argument can be looked up in
+        // the index, or must be found with the matchers instead
+        std::vector<bool> InIndex;
+        for (auto Exp : Expansions)
+            for (auto &&Arg : Exp->Arguments)
+            {
+                if (Arg.Tokens.empty())
+                    continue;
+
+                auto TokB = SM.getFileLoc(Arg.Tokens.front().getLocation());
+                auto TokE = SM.getFileLoc(Arg.Tokens.back().getLocation());
+                if (TokB.isInvalid() || TokE.isInvalid())
+                    continue;
+
+                Args.push_back(&Arg);
+                ArgRanges.emplace_back(TokB, TokE);
+                InIndex.push_back(Index.covers(ArgRanges.back()));
+            }
+
+        // As for expansions, find candidates first and claim them after
+        std::vector<std::vector<const ASTNodeIndex::Entry *>>
+            Candidates(Args.size());
+        parallelForWithLocations(
+            Pool, Args.size(), Context,
+            [&](unsigned I, SourceLocationCache &Locs)
+            {
+                if (!InIndex[I])
+                    return;
+
+                for (auto Table : {&Index.Stmts, &Index.Decls, &Index.TypeLocs})
+                    for (auto E : Table->withFileRange(ArgRanges[I]))
+                        prewarmNode(Locs, E->Node);
+                for (auto &&Tok : Args[I]->Tokens)
+                    Locs.prewarm(Tok.getLocation());
+            },
+            [&](unsigned I, SourceLocationCache &Locs)
+            {
+                if (!InIndex[I])
+                    return;
+
+                auto &Tokens = Args[I]->Tokens;
+                for (auto E : Index.Stmts.withFileRange(ArgRanges[I]))
+                    if (isSpelledFromTokenList(*E->Node.ST, Locs, Tokens))
+                        Candidates[I].push_back(E);
+
+                for (auto E : Index.Decls.withFileRange(ArgRanges[I]))
+                    if (isSpelledFromTokenList(*E->Node.D, Locs, Tokens))
+                        Candidates[I].push_back(E);
+
+                for (auto E : Index.TypeLocs.withFileRange(ArgRanges[I]))
+                    if (isSpelledFromTokenList(*E->Node.TL, Locs, Tokens))
+                        Candidates[I].push_back(E);
+            });
+
+        for (unsigned I = 0; I < Args.size(); I++)
+            if (!InIndex[I])
+                findAlignedASTNodesForArgument(*Args[I], Context);
+            else
+                for (auto E : Candidates[I])
+                    if (claimAlignedNode(E->Node, &Ctx,
+                                         Context.claimedBy(E->Node),
+                                         false))
+                        Args[I]->AlignedRoots.push_back(E->Node);
+    }
+
+    void findAlignedASTNodesForExpansion(
         cpp2c::MacroExpansionNode *Exp,
-        clang::ASTContext &Ctx)
+        cpp2c::AlignmentContext &BodyContext,
+        cpp2c::AlignmentContext &ArgumentContext)
     {
+        auto &Ctx = BodyContext.Ctx;
 
         using namespace clang::ast_matchers;
         // Find AST nodes aligned with the entire invocation
@@ -64,7 +397,7 @@ namespace cpp2c
             ExpansionMatchHandler Handler;
             auto Matcher = stmt(unless(anyOf(implicitCastExpr(),
                                              implicitValueInitExpr())),
-                                alignsWithExpansion(&Ctx, Exp))
+                                alignsWithExpansion(&BodyContext, Exp))
                                .bind("root");
             Finder.addMatcher(Matcher, &Handler);
             Finder.matchAST(Ctx);
@@ -72,11 +405,24 @@ namespace cpp2c
                 Exp->ASTRoots.push_back(M);
         }
 
+        // If the expansion aligns with a single expression, then there are
+        // no Decls or TypeLocs left to find
+        if (BodyContext.Tiered && Exp->ASTRoots.size() == 1 &&
+            rulesOutDeclAndTypeLocAlignment(Exp->ASTRoots.front().ST))
+        {
+            BodyContext.AlignedByStmtTier++;
+            Exp->AlignedRoot = &(Exp->ASTRoots.front());
+            findAlignedASTNodesForArguments(Exp, ArgumentContext);
+            return;
+        }
+        if (BodyContext.Tiered)
+            BodyContext.AlignedByAllTiers++;
+
         // Match decls
         {
             MatchFinder Finder;
             ExpansionMatchHandler Handler;
-            auto Matcher = decl(alignsWithExpansion(&Ctx, Exp))
+            auto Matcher = decl(alignsWithExpansion(&BodyContext, Exp))
                                .bind("root");
             Finder.addMatcher(Matcher, &Handler);
             Finder.matchAST(Ctx);
@@ -88,7 +434,7 @@ namespace cpp2c
         {
             MatchFinder Finder;
             ExpansionMatchHandler Handler;
-            auto Matcher = typeLoc(alignsWithExpansion(&Ctx, (Exp)))
+            auto Matcher = typeLoc(alignsWithExpansion(&BodyContext, (Exp)))
                                .bind("root");
             Finder.addMatcher(Matcher, &Handler);
             Finder.matchAST(Ctx);
@@ -102,48 +448,63 @@ namespace cpp2c
                                ? (&(Exp->ASTRoots.front()))
                                : nullptr;
 
-        //// Find AST nodes aligned with each of the expansion's arguments
+        findAlignedASTNodesForArguments(Exp, ArgumentContext);
+    }
 
+    void findAlignedASTNodesForArguments(
+        cpp2c::MacroExpansionNode *Exp,
+        cpp2c::AlignmentContext &Context)
+    {
+        // Find AST nodes aligned with each of the expansion's arguments
         for (auto &&Arg : Exp->Arguments)
+            findAlignedASTNodesForArgument(Arg, Context);
+    }
+
+    void findAlignedASTNodesForArgument(
+        cpp2c::MacroExpansionArgument &Arg,
+        cpp2c::AlignmentContext &Context)
+    {
+        auto &Ctx = Context.Ctx;
+
+        using namespace clang::ast_matchers;
+
+        // Match stmts
         {
-            // Match stmts
-            {
-                MatchFinder Finder;
-                ExpansionMatchHandler Handler;
-                auto Matcher = stmt(unless(anyOf(implicitCastExpr(),
-                                                 implicitValueInitExpr())),
-                                    isSpelledFromTokens(&Ctx, Arg.Tokens))
-                                   .bind("root");
-                Finder.addMatcher(Matcher, &Handler);
-                Finder.matchAST(Ctx);
-                for (auto &&M : Handler.Matches)
-                    Arg.AlignedRoots.push_back(M);
-            }
+            MatchFinder Finder;
+            ExpansionMatchHandler Handler;
+            auto Matcher = stmt(unless(anyOf(implicitCastExpr(),
+                                             implicitValueInitExpr())),
+                                isSpelledFromTokens(&Context, Arg.Tokens))
+                               .bind("root");
+            Finder.addMatcher(Matcher, &Handler);
+            Finder.matchAST(Ctx);
+            for (auto &&M : Handler.Matches)
+                Arg.AlignedRoots.push_back(M);
+        }
 
-            // Match decls
-            {
-                MatchFinder Finder;
-                ExpansionMatchHandler Handler;
-                auto Matcher = decl(isSpelledFromTokens(&Ctx, Arg.Tokens))
-                                   .bind("root");
-                Finder.addMatcher(Matcher, &Handler);
-                Finder.matchAST(Ctx);
-                for (auto &&M : Handler.Matches)
-                    Arg.AlignedRoots.push_back(M);
-            }
+        // Match decls
+        {
+            MatchFinder Finder;
+            ExpansionMatchHandler Handler;
+            auto Matcher = decl(isSpelledFromTokens(&Context, Arg.Tokens))
+                               .bind("root");
+            Finder.addMatcher(Matcher, &Handler);
+            Finder.matchAST(Ctx);
+            for (auto &&M : Handler.Matches)
+                Arg.AlignedRoots.push_back(M);
+        }
 
-            // Match type locs
-            {
-                MatchFinder Finder;
-                ExpansionMatchHandler Handler;
-                auto Matcher =
-                    typeLoc(isSpelledFromTokens(&Ctx, Arg.Tokens))
-                        .bind("root");
-                Finder.addMatcher(Matcher, &Handler);
-                Finder.matchAST(Ctx);
-                for (auto &&M : Handler.Matches)
-                    Arg.AlignedRoots.push_back(M);
-            }
+        // Match type locs
+        {
+            MatchFinder Finder;
+            ExpansionMatchHandler Handler;
+            auto Matcher =
+                typeLoc(isSpelledFromTokens(&Context, Arg.Tokens))
+                    .bind("root");
+            Finder.addMatcher(Matcher, &Handler);
+            Finder.matchAST(Ctx);
+            for (auto &&M : Handler.Matches)
+                Arg.AlignedRoots.push_back(M);
         }
     }
 } // namespace cpp2c
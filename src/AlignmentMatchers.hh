@@ -1,12 +1,17 @@
 #pragma once
 
+#include "AlignmentContext.hh"
+#include "ASTNodeIndex.hh"
 #include "DeclStmtTypeLoc.hh"
 #include "MacroExpansionNode.hh"
+#include "SourceLocationCache.hh"
 
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Lex/Lexer.h"
 #include "clang/AST/ASTContext.h"
 
+#include "llvm/Support/ThreadPool.h"
+
 #include <algorithm>
 
 namespace cpp2c
@@ -14,20 +19,16 @@ namespace cpp2c
     using namespace clang::ast_matchers;
 
     void storeChildren(cpp2c::DeclStmtTypeLoc DSTL,
-                       std::set<const clang::Stmt *> &MatchedStmts,
-                       std::set<const clang::Decl *> &MatchedDecls,
-                       std::set<const clang::TypeLoc *> &MatchedTypeLocs);
-
-    // Matches all AST nodes that align perfectly with the body of the given
-    // macro expansion.
-    // Only tested to work with top-level, non-argument expansions.
-    AST_POLYMORPHIC_MATCHER_P2(
-        alignsWithExpansion,
-        AST_POLYMORPHIC_SUPPORTED_TYPES(clang::Decl,
-                                        clang::Stmt,
-                                        clang::TypeLoc),
-        clang::ASTContext *, Ctx,
-        cpp2c::MacroExpansionNode *, Expansion)
+                       cpp2c::ClaimedNodes &Claimed);
+
+    // Checks whether the given node's source locations align perfectly with
+    // the body of the given macro expansion.
+    // This only checks the node's own locations; it does not check whether
+    // the node lies under a node that was already aligned with the expansion.
+    template <typename NodeT>
+    bool isAlignedWithExpansion(const NodeT &Node,
+                                cpp2c::SourceLocationCache &Locs,
+                                cpp2c::MacroExpansionNode *Expansion)
     {
         // Can't match an expansion with no tokens
         if (Expansion->DefinitionTokens.empty())
@@ -42,31 +43,25 @@ namespace cpp2c
         if (DefB.isInvalid() || DefE.isInvalid())
             return false;
 
-        // These sets keep track of nodes we have already matched,
-        // so that we do not match their subtrees as well
-        static std::set<const clang::Stmt *> MatchedStmts; // Also includes Exprs, can be casted
-        static std::set<const clang::Decl *> MatchedDecls;
-        static std::set<const clang::TypeLoc *> MatchedTypeLocs;
-        // Note these are STATIC, so they will persist between invocations
-        // This matcher cannot be used twice in the same translation unit
-
         // Collect a bunch of SourceLocation information up front that may be
         // useful later
 
-        auto &SM = Ctx->getSourceManager();
-
-        auto NodeSpB = SM.getSpellingLoc(Node.getBeginLoc());
-        auto NodeSpE = SM.getSpellingLoc(Node.getEndLoc());
-        auto NodeExB = SM.getExpansionLoc(Node.getBeginLoc());
-        auto NodeExE = SM.getExpansionLoc(Node.getEndLoc());
-        auto ImmMacroCallerLocSpB = SM.getSpellingLoc(
-            SM.getImmediateMacroCallerLoc(Node.getBeginLoc()));
-        auto ImmMacroCallerLocSpE = SM.getSpellingLoc(
-            SM.getImmediateMacroCallerLoc(Node.getEndLoc()));
-        auto ImmMacroCallerLocExB = SM.getExpansionLoc(
-            SM.getImmediateMacroCallerLoc(Node.getBeginLoc()));
-        auto ImmMacroCallerLocExE = SM.getExpansionLoc(
-            SM.getImmediateMacroCallerLoc(Node.getEndLoc()));
+        auto &SM = Locs.SM;
+
+        auto NodeLocsB = Locs.decompose(Node.getBeginLoc());
+        auto NodeLocsE = Locs.decompose(Node.getEndLoc());
+        auto NodeSpB = NodeLocsB.Spelling;
+        auto NodeSpE = NodeLocsE.Spelling;
+        auto NodeExB = NodeLocsB.Expansion;
+        auto NodeExE = NodeLocsE.Expansion;
+        auto ImmMacroCallerLocSpB = Locs.getSpellingLoc(
+            NodeLocsB.ImmediateMacroCaller);
+        auto ImmMacroCallerLocSpE = Locs.getSpellingLoc(
+            NodeLocsE.ImmediateMacroCaller);
+        auto ImmMacroCallerLocExB = Locs.getExpansionLoc(
+            NodeLocsB.ImmediateMacroCaller);
+        auto ImmMacroCallerLocExE = Locs.getExpansionLoc(
+            NodeLocsE.ImmediateMacroCaller);
         DeclStmtTypeLoc DSTL(&Node);
 
         static const constexpr bool debug = false;
@@ -126,7 +121,7 @@ namespace cpp2c
             {
                 auto L = Arg->Tokens.front().getLocation();
                 if (L.isValid())
-                    ArgB = SM.getSpellingLoc(L);
+                    ArgB = Locs.getSpellingLoc(L);
             }
         }
         clang::SourceLocation ArgE;
@@ -136,22 +131,22 @@ namespace cpp2c
             {
                 auto L = Arg->Tokens.back().getLocation();
                 if (L.isValid())
-                    ArgE = SM.getSpellingLoc(L);
+                    ArgE = Locs.getSpellingLoc(L);
             }
         }
 
         // Set up case 3
         clang::SourceLocation B = Node.getBeginLoc();
-        while (SM.getImmediateMacroCallerLoc(B).isMacroID() &&
-               SM.getImmediateMacroCallerLoc(B).isValid())
-            B = SM.getImmediateMacroCallerLoc(B);
-        B = SM.getSpellingLoc(B);
+        while (Locs.getImmediateMacroCallerLoc(B).isMacroID() &&
+               Locs.getImmediateMacroCallerLoc(B).isValid())
+            B = Locs.getImmediateMacroCallerLoc(B);
+        B = Locs.getSpellingLoc(B);
 
         clang::SourceLocation E = Node.getEndLoc();
-        while (SM.getImmediateMacroCallerLoc(E).isMacroID() &&
-               SM.getImmediateMacroCallerLoc(E).isValid())
-            E = SM.getImmediateMacroCallerLoc(E);
-        E = SM.getSpellingLoc(E);
+        while (Locs.getImmediateMacroCallerLoc(E).isMacroID() &&
+               Locs.getImmediateMacroCallerLoc(E).isValid())
+            E = Locs.getImmediateMacroCallerLoc(E);
+        E = Locs.getSpellingLoc(E);
 
         bool frontAligned =
             // Case 1
@@ -278,99 +273,87 @@ namespace cpp2c
             return false;
         }
 
-        // Check that this node has not been matched before
-        bool foundNodeBefore = false;
-        if (DSTL.ST && MatchedStmts.find(DSTL.ST) != MatchedStmts.end())
-            foundNodeBefore = true;
-        else if (DSTL.D && MatchedDecls.find(DSTL.D) != MatchedDecls.end())
-            foundNodeBefore = true;
-        else if (DSTL.TL &&
-                 MatchedTypeLocs.find(DSTL.TL) != MatchedTypeLocs.end())
-            foundNodeBefore = true;
-        if (foundNodeBefore)
-        {
-            if (debug)
-            {
-                llvm::errs() << "Found node before\n";
-                if (DSTL.ST)
-                    DSTL.ST->dumpColor();
-                else if (DSTL.D)
-                    DSTL.D->dumpColor();
-                else if (DSTL.TL)
-                {
-                    auto QT = DSTL.TL->getType();
-                    if (!QT.isNull())
-                        QT.dump();
-                    else
-                        llvm::errs() << "<Null type>\n";
-                }
-            }
-            return false;
-        }
+        return true;
+    }
 
-        // Check that this node is not a proper subtree of an aligned node
-        // that we already found.
-        bool foundParentBefore = false;
-        for (auto P : Ctx->getParents(Node))
+    // Checks that the given node has not already been claimed, and if
+    // CheckParents is set, that none of its parents have either.
+    // If so, claims the node and its descendants and returns true.
+    bool claimAlignedNode(cpp2c::DeclStmtTypeLoc DSTL,
+                          clang::ASTContext *Ctx,
+                          cpp2c::ClaimedNodes &Claimed,
+                          bool CheckParents = true);
+
+    // Returns false if the context's expansion location table shows that
+    // the given node begins or ends with a token from a different
+    // outermost expansion than the given expansion was expanded under, in
+    // which case the node cannot align with the expansion.
+    // This only looks up a few locations, so it is much cheaper than
+    // isAlignedWithExpansion.
+    template <typename NodeT>
+    bool mayAlignWithExpansion(const NodeT &Node,
+                               const cpp2c::AlignmentContext &Context,
+                               const cpp2c::MacroExpansionNode *Exp)
+    {
+        if (!Context.ExpansionLocs)
+            return true;
+
+        auto &SM = Context.Ctx.getSourceManager();
+        auto &Locs = *Context.ExpansionLocs;
+        auto Root = Exp->ExpansionBegin.isMacroID()
+                        ? Locs.outermostExpansionOf(SM, Exp->ExpansionBegin)
+                        : Exp;
+        if (!Root)
+            return true;
+
+        for (auto L : {Node.getBeginLoc(), Node.getEndLoc()})
         {
-            if (auto PST = P.template get<clang::Stmt>())
-            {
-                if (MatchedStmts.find(PST) != MatchedStmts.end())
-                    foundParentBefore = true;
-            }
-            else if (auto DP = P.template get<clang::Decl>())
-            {
-                if (MatchedDecls.find(DP) != MatchedDecls.end())
-                    foundParentBefore = true;
-            }
-            else if (auto DTL = P.template get<clang::TypeLoc>())
-            {
-                if (MatchedTypeLocs.find(DTL) != MatchedTypeLocs.end())
-                    foundParentBefore = true;
-            }
+            auto NodeRoot = Locs.outermostExpansionOf(SM, L);
+            if (NodeRoot && NodeRoot != Root)
+                return false;
         }
-        if (foundParentBefore)
-        {
-            if (debug)
-            {
-                llvm::errs() << "Found parent before\n";
-            }
+        return true;
+    }
+
+    // Matches all AST nodes that align perfectly with the body of the given
+    // macro expansion.
+    // Matched nodes are claimed in the given context, so that their subtrees
+    // are not matched as well; use the same context for every expansion in
+    // a translation unit.
+    // Only tested to work with top-level, non-argument expansions.
+    AST_POLYMORPHIC_MATCHER_P2(
+        alignsWithExpansion,
+        AST_POLYMORPHIC_SUPPORTED_TYPES(clang::Decl,
+                                        clang::Stmt,
+                                        clang::TypeLoc),
+        cpp2c::AlignmentContext *, Context,
+        cpp2c::MacroExpansionNode *, Expansion)
+    {
+        if (!mayAlignWithExpansion(Node, *Context, Expansion) ||
+            !isAlignedWithExpansion(Node, Context->Locations, Expansion))
             return false;
-        }
 
-        // Store this node and its children in the set of aligned subtrees
-        // we've found
-        storeChildren(DSTL, MatchedStmts, MatchedDecls, MatchedTypeLocs);
+        if (!claimAlignedNode(DeclStmtTypeLoc(&Node), &Context->Ctx,
+                              Context->claimedBy(Node)))
+            return false;
 
+        static const constexpr bool debug = false;
         if (debug)
         {
+            DeclStmtTypeLoc DSTL(&Node);
             llvm::errs() << "Matched " << Expansion->Name << " with:\n";
-            if (DSTL.ST)
-                DSTL.ST->dumpColor();
-            else if (DSTL.D)
-                DSTL.D->dumpColor();
-            else if (DSTL.TL)
-            {
-                auto QT = DSTL.TL->getType();
-                if (!QT.isNull())
-                    QT.dump();
-                else
-                    llvm::errs() << "<Null type>\n";
-            }
+            DSTL.dump();
         }
         return true;
     }
 
-    // Matches all AST nodes who span the same range that the
-    // given token list spans, and for whose range every token
-    // in the list is spelled
-    AST_POLYMORPHIC_MATCHER_P2(
-        isSpelledFromTokens,
-        AST_POLYMORPHIC_SUPPORTED_TYPES(clang::Decl,
-                                        clang::Stmt,
-                                        clang::TypeLoc),
-        clang::ASTContext *, Ctx,
-        std::vector<clang::Token>, Tokens)
+    // Checks whether the given node spans the same range that the given
+    // token list spans, and every token in the list is spelled within the
+    // node's range
+    template <typename NodeT>
+    bool isSpelledFromTokenList(const NodeT &Node,
+                                cpp2c::SourceLocationCache &Locs,
+                                const std::vector<clang::Token> &Tokens)
     {
         // First ensure that the token list is not empty, because if it is,
         // then of course it is impossible for a node to be spelled from an
@@ -378,59 +361,45 @@ namespace cpp2c
         if (Tokens.empty())
             return false;
 
-        auto &SM = Ctx->getSourceManager();
+        auto &SM = Locs.SM;
 
-        auto NodeB = SM.getFileLoc(Node.getBeginLoc());
-        auto NodeE = SM.getFileLoc(Node.getEndLoc());
+        auto NodeB = Locs.getFileLoc(Node.getBeginLoc());
+        auto NodeE = Locs.getFileLoc(Node.getEndLoc());
         if (NodeB.isInvalid() || NodeE.isInvalid())
             return false;
 
-        auto TokB = SM.getFileLoc(Tokens.front().getLocation());
+        auto TokB = Locs.getFileLoc(Tokens.front().getLocation());
         // Note: We do NOT use getEndLoc for the last token!
-        auto TokE = SM.getFileLoc(Tokens.back().getLocation());
+        auto TokE = Locs.getFileLoc(Tokens.back().getLocation());
         if (TokB.isInvalid() || TokE.isInvalid())
             return false;
 
-        auto NodeImmMCB = SM.getImmediateMacroCallerLoc(Node.getBeginLoc());
-        auto NodeImmMCE = SM.getImmediateMacroCallerLoc(Node.getEndLoc());
+        auto NodeImmMCB = Locs.getImmediateMacroCallerLoc(Node.getBeginLoc());
+        auto NodeImmMCE = Locs.getImmediateMacroCallerLoc(Node.getEndLoc());
 
         if (NodeImmMCB.isInvalid() || NodeImmMCE.isInvalid())
             return false;
 
-        // These sets keep track of nodes we have already matched,
-        // so that we do not match their subtrees as well
-        static std::set<const clang::Stmt *> MatchedStmts;
-        static std::set<const clang::Decl *> MatchedDecls;
-        static std::set<const clang::TypeLoc *> MatchedTypeLocs;
-
         static const constexpr bool debug = false;
 
         clang::SourceRange SpellingRange(NodeB, NodeE);
         clang::SourceRange TokFileRange(TokB, TokE);
         clang::SourceRange TokExpRange(
-            SM.getExpansionLoc(TokB),
-            SM.getExpansionLoc(TokE));
+            Locs.getExpansionLoc(TokB),
+            Locs.getExpansionLoc(TokE));
         clang::SourceRange ExpImmMacroCallerRange(
-            SM.getExpansionLoc(NodeImmMCB),
-            SM.getExpansionLoc(NodeImmMCE));
+            Locs.getExpansionLoc(NodeImmMCB),
+            Locs.getExpansionLoc(NodeImmMCE));
 
-        // Check that this node has not been matched before
         DeclStmtTypeLoc DSTL(&Node);
-        if (DSTL.ST && MatchedStmts.find(DSTL.ST) != MatchedStmts.end())
-            return false;
-        else if (DSTL.D && MatchedDecls.find(DSTL.D) != MatchedDecls.end())
-            return false;
-        else if (DSTL.TL &&
-                 MatchedTypeLocs.find(DSTL.TL) != MatchedTypeLocs.end())
-            return false;
 
         // Ensure that every token in the list is included
         // in the range spanned by this AST node
         for (auto Tok : Tokens)
             if (!(SpellingRange
-                      .fullyContains(SM.getExpansionLoc(Tok.getLocation())) ||
+                      .fullyContains(Locs.getExpansionLoc(Tok.getLocation())) ||
                   ExpImmMacroCallerRange.fullyContains(
-                      SM.getExpansionLoc(Tok.getLocation()))))
+                      Locs.getExpansionLoc(Tok.getLocation()))))
             {
                 if (DSTL.ST && debug)
                 {
@@ -492,22 +461,22 @@ namespace cpp2c
                 if (CurB.isInvalid() || CurE.isInvalid())
                     continue;
 
-                auto CurFB = SM.getFileLoc(CurB);
-                auto CurFE = SM.getFileLoc(CurE);
+                auto CurFB = Locs.getFileLoc(CurB);
+                auto CurFE = Locs.getFileLoc(CurE);
 
                 if (CurFB.isInvalid() || CurFE.isInvalid())
                     continue;
 
                 clang::SourceRange FileRange(CurFB, CurFE);
 
-                auto CurImmMCB = SM.getImmediateMacroCallerLoc(CurB);
-                auto CurImmMCE = SM.getImmediateMacroCallerLoc(CurE);
+                auto CurImmMCB = Locs.getImmediateMacroCallerLoc(CurB);
+                auto CurImmMCE = Locs.getImmediateMacroCallerLoc(CurE);
 
                 if (CurImmMCB.isInvalid() || CurImmMCE.isInvalid())
                     continue;
 
-                auto CurImmMCExB = SM.getExpansionLoc(CurImmMCB);
-                auto CurImmMCExE = SM.getExpansionLoc(CurImmMCE);
+                auto CurImmMCExB = Locs.getExpansionLoc(CurImmMCB);
+                auto CurImmMCExE = Locs.getExpansionLoc(CurImmMCE);
 
                 if (CurImmMCExB.isInvalid() || CurImmMCExE.isInvalid())
                     continue;
@@ -549,14 +518,79 @@ namespace cpp2c
             }
         }
 
-        // Store this node and its children in the set of aligned subtrees
-        // we've found
-        storeChildren(DSTL, MatchedStmts, MatchedDecls, MatchedTypeLocs);
-
         return true;
     }
 
+    // Matches all AST nodes who span the same range that the
+    // given token list spans, and for whose range every token
+    // in the list is spelled.
+    // Matched nodes are claimed in the given context, which should be
+    // separate from the one used for alignsWithExpansion.
+    AST_POLYMORPHIC_MATCHER_P2(
+        isSpelledFromTokens,
+        AST_POLYMORPHIC_SUPPORTED_TYPES(clang::Decl,
+                                        clang::Stmt,
+                                        clang::TypeLoc),
+        cpp2c::AlignmentContext *, Context,
+        std::vector<clang::Token>, Tokens)
+    {
+        if (!isSpelledFromTokenList(Node, Context->Locations, Tokens))
+            return false;
+
+        return claimAlignedNode(DeclStmtTypeLoc(&Node), &Context->Ctx,
+                                Context->claimedBy(Node), false);
+    }
+
+    // Returns true if no Decl or TypeLoc can align with an expansion that
+    // the given Stmt aligns with.
+    // An expression spans different tokens than any declaration or type,
+    // except for lambdas and blocks, which span the same tokens as their
+    // implicit class or block declaration.
+    bool rulesOutDeclAndTypeLocAlignment(const clang::Stmt *ST);
+
+    // Finds the AST nodes aligned with the body and each argument of the
+    // given expansion, claiming them in the given body and argument
+    // contexts respectively
     void findAlignedASTNodesForExpansion(
         cpp2c::MacroExpansionNode *Exp,
-        clang::ASTContext &Ctx);
+        cpp2c::AlignmentContext &BodyContext,
+        cpp2c::AlignmentContext &ArgumentContext);
+
+    // Finds the AST nodes aligned with each of the given expansion's
+    // arguments
+    void findAlignedASTNodesForArguments(
+        cpp2c::MacroExpansionNode *Exp,
+        cpp2c::AlignmentContext &Context);
+
+    // Finds the AST nodes aligned with the given argument
+    void findAlignedASTNodesForArgument(
+        cpp2c::MacroExpansionArgument &Arg,
+        cpp2c::AlignmentContext &Context);
+
+    // Finds the AST nodes aligned with the bodies of each of the given
+    // top-level expansions by looking up candidate nodes in the index.
+    // Expansions must be given in the order they were expanded.
+    // The index must outlive the expansions' ASTRoots.
+    // If a thread pool is given, then candidates are checked for alignment
+    // on its threads. The SourceManager is only queried from the calling
+    // thread, or under a lock, and nodes are still claimed in order on the
+    // calling thread.
+    void findAlignedASTNodesForExpansions(
+        std::vector<cpp2c::MacroExpansionNode *> &Expansions,
+        cpp2c::AlignmentContext &Context,
+        const cpp2c::ASTNodeIndex &Index,
+        llvm::ThreadPool *Pool = nullptr);
+
+    // Finds the AST nodes aligned with the arguments of each of the given
+    // top-level expansions by looking up the nodes spanning each
+    // argument's exact file range in the index.
+    // Arguments outside of the index's scope are aligned with the matchers.
+    // Expansions must be given in the order they were expanded.
+    // The index must outlive the arguments' AlignedRoots.
+    // A thread pool is used in the same way as for expansions.
+    void findAlignedASTNodesForArguments(
+        std::vector<cpp2c::MacroExpansionNode *> &Expansions,
+        cpp2c::AlignmentContext &Context,
+        const cpp2c::ASTNodeIndex &Index,
+        llvm::ThreadPool *Pool = nullptr);
 }
@@ -2,12 +2,14 @@
 #include "ExpansionMatchHandler.hh"
 
 #include <optional>
+#include <vector>
 
 namespace cpp2c
 {
     std::optional<DeclStmtTypeLoc> findBoundingASTNodesForRange(
         clang::SourceRange Range,
-        clang::ASTContext &Ctx)
+        clang::ASTContext &Ctx,
+        cpp2c::SourceLocationCache &Locs)
     {
         using namespace clang::ast_matchers;
         // Find AST nodes aligned with the entire invocation
@@ -20,7 +22,7 @@ namespace cpp2c
             ExpansionMatchHandler Handler;
             auto Matcher = stmt(unless(anyOf(implicitCastExpr(),
                                              implicitValueInitExpr())),
-                                boundsRange(&Ctx, Range))
+                                boundsRange(&Locs, Range))
                                .bind("root");
             Finder.addMatcher(Matcher, &Handler);
             Finder.matchAST(Ctx);
@@ -32,7 +34,7 @@ namespace cpp2c
         {
             MatchFinder Finder;
             ExpansionMatchHandler Handler;
-            auto Matcher = decl(boundsRange(&Ctx, Range))
+            auto Matcher = decl(boundsRange(&Locs, Range))
                                .bind("root");
             Finder.addMatcher(Matcher, &Handler);
             Finder.matchAST(Ctx);
@@ -44,7 +46,7 @@ namespace cpp2c
         {
             MatchFinder Finder;
             ExpansionMatchHandler Handler;
-            auto Matcher = typeLoc(boundsRange(&Ctx, (Range)))
+            auto Matcher = typeLoc(boundsRange(&Locs, (Range)))
                                .bind("root");
             Finder.addMatcher(Matcher, &Handler);
             Finder.matchAST(Ctx);
@@ -52,6 +54,51 @@ namespace cpp2c
                 Matches.push_back(M);
         }
 
+        return findSmallestBoundingNode(Matches);
+    }
+
+    std::optional<DeclStmtTypeLoc> findBoundingASTNodesForRange(
+        clang::SourceRange Range,
+        cpp2c::SourceLocationCache &Locs,
+        const cpp2c::ASTNodeIndex &Index)
+    {
+        std::vector<DeclStmtTypeLoc> Matches;
+
+        // Only nodes whose expansion end lies within the range can bound it
+        for (auto E : Index.Stmts.expansionEndsWithin(Range))
+            if (isBoundingRange(*E->Node.ST, Locs, Range))
+                Matches.push_back(E->Node);
+        for (auto E : Index.Decls.expansionEndsWithin(Range))
+            if (isBoundingRange(*E->Node.D, Locs, Range))
+                Matches.push_back(E->Node);
+        for (auto E : Index.TypeLocs.expansionEndsWithin(Range))
+            if (isBoundingRange(*E->Node.TL, Locs, Range))
+                Matches.push_back(E->Node);
+
+        return findSmallestBoundingNode(Matches);
+    }
+
+    std::vector<std::optional<DeclStmtTypeLoc>> findBoundingASTNodesForRanges(
+        const std::vector<clang::SourceRange> &Ranges,
+        clang::ASTContext &Ctx,
+        cpp2c::SourceLocationCache &Locs,
+        const cpp2c::ASTNodeIndex &Index)
+    {
+        std::vector<std::optional<DeclStmtTypeLoc>> Results;
+        Results.reserve(Ranges.size());
+        for (auto &&Range : Ranges)
+            if (Index.covers(Range))
+                Results.push_back(
+                    findBoundingASTNodesForRange(Range, Locs, Index));
+            else
+                Results.push_back(
+                    findBoundingASTNodesForRange(Range, Ctx, Locs));
+        return Results;
+    }
+
+    std::optional<DeclStmtTypeLoc> findSmallestBoundingNode(
+        std::vector<DeclStmtTypeLoc> &Matches)
+    {
         // In all matches, find the smallest range that fully contains the given range
 
         std::optional<DeclStmtTypeLoc> BestMatch;
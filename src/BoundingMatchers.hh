@@ -1,7 +1,9 @@
 #pragma once
 
+#include "ASTNodeIndex.hh"
 #include "DeclStmtTypeLoc.hh"
 #include "MacroExpansionNode.hh"
+#include "SourceLocationCache.hh"
 
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Lex/Lexer.h"
@@ -9,24 +11,17 @@
 
 #include <algorithm>
 #include <optional>
+#include <vector>
 
 namespace cpp2c
 {
     using namespace clang::ast_matchers;
 
-    void storeChildren(cpp2c::DeclStmtTypeLoc DSTL,
-                       std::set<const clang::Stmt *> &MatchedStmts,
-                       std::set<const clang::Decl *> &MatchedDecls,
-                       std::set<const clang::TypeLoc *> &MatchedTypeLocs);
-
-    // Matches all AST nodes that bounds the given range.
-    AST_POLYMORPHIC_MATCHER_P2(
-        boundsRange,
-        AST_POLYMORPHIC_SUPPORTED_TYPES(clang::Decl,
-                                        clang::Stmt,
-                                        clang::TypeLoc),
-        clang::ASTContext *, Ctx,
-        clang::SourceRange, Range)
+    // Checks whether the given node bounds the given range.
+    template <typename NodeT>
+    bool isBoundingRange(const NodeT &Node,
+                         cpp2c::SourceLocationCache &Locs,
+                         clang::SourceRange Range)
     {
         // Can't match an invalid location
         if (Node.getBeginLoc().isInvalid() || Node.getEndLoc().isInvalid())
@@ -37,33 +32,27 @@ namespace cpp2c
         if (DefB.isInvalid() || DefE.isInvalid())
             return false;
 
-        // These sets keep track of nodes we have already matched,
-        // so that we do not match their subtrees as well
-        static std::set<const clang::Stmt *> MatchedStmts; // Also includes Exprs, can be casted
-        static std::set<const clang::Decl *> MatchedDecls;
-        static std::set<const clang::TypeLoc *> MatchedTypeLocs;
-        // Note these are STATIC, so they will persist between invocations
-        // This matcher cannot be used twice in the same translation unit
-
         // Collect a bunch of SourceLocation information up front that may be
         // useful later
 
-        auto &SM = Ctx->getSourceManager();
+        auto &SM = Locs.SM;
 
+        auto NodeLocsB = Locs.decompose(Node.getBeginLoc());
+        auto NodeLocsE = Locs.decompose(Node.getEndLoc());
         // Pre-preprocessing locations
-        auto NodeSpB = SM.getSpellingLoc(Node.getBeginLoc());
-        auto NodeSpE = SM.getSpellingLoc(Node.getEndLoc());
+        auto NodeSpB = NodeLocsB.Spelling;
+        auto NodeSpE = NodeLocsE.Spelling;
         // Post-preprocessing locations
-        auto NodeExB = SM.getExpansionLoc(Node.getBeginLoc());
-        auto NodeExE = SM.getExpansionLoc(Node.getEndLoc());
-        auto ImmMacroCallerLocSpB = SM.getSpellingLoc(
-            SM.getImmediateMacroCallerLoc(Node.getBeginLoc()));
-        auto ImmMacroCallerLocSpE = SM.getSpellingLoc(
-            SM.getImmediateMacroCallerLoc(Node.getEndLoc()));
-        auto ImmMacroCallerLocExB = SM.getExpansionLoc(
-            SM.getImmediateMacroCallerLoc(Node.getBeginLoc()));
-        auto ImmMacroCallerLocExE = SM.getExpansionLoc(
-            SM.getImmediateMacroCallerLoc(Node.getEndLoc()));
+        auto NodeExB = NodeLocsB.Expansion;
+        auto NodeExE = NodeLocsE.Expansion;
+        auto ImmMacroCallerLocSpB = Locs.getSpellingLoc(
+            NodeLocsB.ImmediateMacroCaller);
+        auto ImmMacroCallerLocSpE = Locs.getSpellingLoc(
+            NodeLocsE.ImmediateMacroCaller);
+        auto ImmMacroCallerLocExB = Locs.getExpansionLoc(
+            NodeLocsB.ImmediateMacroCaller);
+        auto ImmMacroCallerLocExE = Locs.getExpansionLoc(
+            NodeLocsE.ImmediateMacroCaller);
         DeclStmtTypeLoc DSTL(&Node);
 
         static const constexpr bool debug = false;
@@ -229,6 +218,25 @@ namespace cpp2c
             return false;
         }
 
+        return true;
+    }
+
+    // Matches all AST nodes that bounds the given range.
+    AST_POLYMORPHIC_MATCHER_P2(
+        boundsRange,
+        AST_POLYMORPHIC_SUPPORTED_TYPES(clang::Decl,
+                                        clang::Stmt,
+                                        clang::TypeLoc),
+        cpp2c::SourceLocationCache *, Locs,
+        clang::SourceRange, Range)
+    {
+        if (!isBoundingRange(Node, *Locs, Range))
+            return false;
+
+        DeclStmtTypeLoc DSTL(&Node);
+
+        static const constexpr bool debug = false;
+
         if (debug)
         {
             llvm::errs() << "Matched Range with:\n";
@@ -250,6 +258,28 @@ namespace cpp2c
 
     std::optional<DeclStmtTypeLoc> findBoundingASTNodesForRange(
         clang::SourceRange Range,
-        clang::ASTContext &Ctx);
+        clang::ASTContext &Ctx,
+        cpp2c::SourceLocationCache &Locs);
+
+    // Same as above, but looks up the candidate nodes in the given index
+    // instead of traversing the entire AST
+    std::optional<DeclStmtTypeLoc> findBoundingASTNodesForRange(
+        clang::SourceRange Range,
+        cpp2c::SourceLocationCache &Locs,
+        const cpp2c::ASTNodeIndex &Index);
+
+    // Finds the best node bounding each of the given ranges by looking up
+    // candidate nodes in the given index, and returns them in the order of
+    // the given ranges.
+    // Ranges outside of the index's scope are answered with the matchers.
+    std::vector<std::optional<DeclStmtTypeLoc>> findBoundingASTNodesForRanges(
+        const std::vector<clang::SourceRange> &Ranges,
+        clang::ASTContext &Ctx,
+        cpp2c::SourceLocationCache &Locs,
+        const cpp2c::ASTNodeIndex &Index);
+
+    // Returns the best of the given nodes bounding a range, if any
+    std::optional<DeclStmtTypeLoc> findSmallestBoundingNode(
+        std::vector<DeclStmtTypeLoc> &Matches);
 
 }
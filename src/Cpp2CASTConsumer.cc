@@ -1,4 +1,5 @@
 #include "Cpp2CASTConsumer.hh"
+#include "ASTNodeIndex.hh"
 #include "ASTUtils.hh"
 #include "DeclStmtTypeLoc.hh"
 #include "DeclCollectorMatchHandler.hh"
@@ -6,17 +7,28 @@
 #include "AlignmentMatchers.hh"
 #include "IncludeCollector.hh"
 #include "Logging.hh"
-#include "StmtCollectorMatchHandler.hh"
+#include "Parallel.hh"
+#include "PropertyNodeSets.hh"
+#include "StmtNumbering.hh"
+#include "StmtOriginTable.hh"
+#include "TranslationUnitOrder.hh"
+#include "TypeFactsTable.hh"
+#include "TypeStringCache.hh"
+#include "SourceLocationCache.hh"
+#include "TokenAlignment.hh"
 
 #include "clang/Lex/Lexer.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "llvm/ADT/StringMap.h"
 
 #include <algorithm>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
-#include <queue>
 
 #include "assert.h"
 
@@ -28,28 +40,6 @@ namespace cpp2c
 {
     using namespace clang::ast_matchers;
 
-    // Collect all subtrees of the given stmt using BFS
-    std::set<const clang::Stmt *> subtrees(const clang::Stmt *ST)
-    {
-        std::set<const clang::Stmt *> Subtrees;
-        if (!ST)
-            return Subtrees;
-
-        std::queue<const clang::Stmt *> Q({ST});
-        while (!Q.empty())
-        {
-            auto Cur = Q.front();
-            Q.pop();
-            if (Cur)
-            {
-                Subtrees.insert(Cur);
-                for (auto &&Child : Cur->children())
-                    Q.push(Child);
-            }
-        }
-        return Subtrees;
-    }
-
     clang::Expr *skipImplicitAndParens(clang::Expr *E)
     {
         while (E && (llvm::isa_and_nonnull<clang::ParenExpr>(E) ||
@@ -61,170 +51,43 @@ namespace cpp2c
         return E;
     }
 
-    // Returns true if LHS is a subtree of RHS via BFS
-    bool inTree(const clang::Stmt *LHS, const clang::Stmt *RHS)
+    // Returns true if LHS is a subtree of RHS
+    bool inTree(const clang::Stmt *LHS, const clang::Stmt *RHS,
+                const StmtNumbering &Numbering)
     {
-        std::queue<const clang::Stmt *> Q({RHS});
-        while (!Q.empty())
-        {
-            auto Cur = Q.front();
-            Q.pop();
-            if (LHS == Cur)
-                return true;
-            if (Cur)
-                for (auto &&Child : Cur->children())
-                    Q.push(Child);
-        }
-        return false;
+        return Numbering.isInTree(LHS, RHS);
     }
 
-    // Returns true if the given predicate returns true for any type
-    // contained in the given type
-    bool isInType(
-        const clang::Type *T,
-        clang::ASTContext &Ctx,
-        std::function<bool(const clang::Type *)> pred)
+    // Returns true if the given Stmt transfers control out of the statement
+    // it appears in
+    bool isControlFlowStmt(const clang::Stmt *St)
     {
-        debug("Checking if T is a pointer type");
-        while (T && (T->isAnyPointerType() || T->isArrayType()))
-            if (T->isAnyPointerType())
-                T = T->getPointeeType().getTypePtrOrNull();
-            else if (T->isArrayType())
-                T = T->getBaseElementTypeUnsafe();
-
-        return pred(T);
+        return llvm::isa_and_nonnull<clang::ReturnStmt>(St) ||
+               llvm::isa_and_nonnull<clang::ContinueStmt>(St) ||
+               llvm::isa_and_nonnull<clang::BreakStmt>(St) ||
+               llvm::isa_and_nonnull<clang::GotoStmt>(St);
     }
 
-    clang::Decl *getTypeDeclOrNull(const clang::Type *T)
+    // Returns true if any type in T was defined after the location with the
+    // given key
+    bool hasTypeDefinedAfter(const clang::Type *T,
+                             TypeFactsTable &Types,
+                             unsigned Key)
     {
-        if (!T)
-            return nullptr;
-
-        if (auto TD = clang::dyn_cast<clang::TypedefType>(T))
-            return TD->getDecl();
-        else if (auto TD = clang::dyn_cast<clang::TagType>(T))
-            return TD->getDecl();
-        else if (auto ET = clang::dyn_cast<clang::ElaboratedType>(T))
-            return getTypeDeclOrNull(ET->desugar().getTypePtrOrNull());
-        else
-            return nullptr;
-    }
-
-    // Returns true if any type in T was defined after L
-    bool hasTypeDefinedAfter(
-        const clang::Type *T,
-        clang::ASTContext &Ctx,
-        clang::SourceLocation L)
-    {
-        auto &SM = Ctx.getSourceManager();
-        return isInType(
-            T,
-            Ctx,
-            [&SM, L](const clang::Type *T)
-            {
-                if (!T)
-                    return false;
-
-                auto *D = getTypeDeclOrNull(T);
-
-                if (!D)
-                    return false;
-
-                auto DLoc = D->getLocation();
-                if (DLoc.isInvalid())
-                    return false;
-
-                auto DFLoc = SM.getFileLoc(DLoc);
-                if (DFLoc.isInvalid())
-                    return false;
-
-                return SM.isBeforeInTranslationUnit(L, DFLoc);
-            });
+        return TranslationUnitOrder::isBefore(
+            Key, Types.factsOf(T).DefinitionKey);
     }
 
     // Returns true if any type in T is an anonymous type
-    bool hasAnonymousType(const clang::Type *T, clang::ASTContext &Ctx)
+    bool hasAnonymousType(const clang::Type *T, TypeFactsTable &Types)
     {
-        return isInType(
-            T,
-            Ctx,
-            [](const clang::Type *T)
-            {
-                if (!T)
-                    return false;
-
-                auto D = getTypeDeclOrNull(T);
-                if (!D)
-                    return false;
-
-                auto ND = clang::dyn_cast<clang::NamedDecl>(D);
-                if (!ND)
-                    return false;
-
-                return ND->getIdentifier() == nullptr || ND->getName().empty();
-            });
+        return Types.factsOf(T).IsAnonymous;
     }
 
     // Returns true if any type in T is a local type
-    bool hasLocalType(const clang::Type *T, clang::ASTContext &Ctx)
+    bool hasLocalType(const clang::Type *T, TypeFactsTable &Types)
     {
-        return isInType(
-            T,
-            Ctx,
-            [](const clang::Type *T)
-            {
-                if (!T)
-                    return false;
-
-                auto D = getTypeDeclOrNull(T);
-                if (!D)
-                    return false;
-
-                auto DCtx = D->getDeclContext();
-
-                return !DCtx->isTranslationUnit();
-            });
-    }
-
-    // Returns true if ST is a descendant of a Stmt which can only have
-    // subexpressions that are integral constants expressions
-    bool isDescendantOfStmtRequiringICE(clang::ASTContext &Ctx,
-                                        const clang::Stmt *ST)
-    {
-        if (!ST)
-            return false;
-
-        std::queue<clang::DynTypedNode> Q;
-        for (auto P : Ctx.getParents(*ST))
-            Q.push(P);
-        while (!Q.empty())
-        {
-            auto Cur = Q.front();
-            Q.pop();
-
-            if (Cur.get<clang::CaseStmt>() ||
-                Cur.get<clang::EnumDecl>())
-                return true;
-
-            if (auto FD = Cur.get<clang::FieldDecl>())
-                if (FD->isBitField())
-                    return true;
-
-            if (auto VD = Cur.get<clang::VarDecl>())
-            {
-                auto QT = VD->getType();
-                if (!QT.isNull())
-                {
-                    if (auto T = QT.getTypePtrOrNull())
-                        if (T->isArrayType())
-                            return true;
-                }
-            }
-
-            for (auto P : Ctx.getParents(Cur))
-                Q.push(P);
-        }
-        return false;
+        return Types.factsOf(T).IsLocal;
     }
 
     std::pair<bool, std::string> tryGetLineColumn(clang::SourceManager &SM, clang::SourceLocation L)
@@ -300,16 +163,64 @@ if (L.isValid())
         return {false, "Invalid SLoc"};
     }
 
+    // Returns the file ranges of the given declarations, each extended to
+    // the end of the token after it, merged into disjoint ranges sorted by
+    // their beginnings
+    std::vector<clang::SourceRange> getMergedDeclRanges(
+        clang::SourceManager &SM,
+        const clang::LangOptions &LO,
+        const std::vector<const clang::Decl *> &Decls)
+    {
+        std::vector<clang::SourceRange> Ranges;
+        for (auto D : Decls)
+        {
+            auto B = SM.getFileLoc(D->getBeginLoc());
+            auto E = SM.getFileLoc(D->getEndLoc());
+
+            if (B.isInvalid() || E.isInvalid())
+                continue;
+
+            // Include the location just after the declaration
+            // to account for semicolons.
+            // If the decl does not have semicolon after it,
+            // that's fine since it would be a non-global
+            // location anyway
+            if (auto Tok = clang::Lexer::findNextToken(E, SM, LO))
+                if (Tok.hasValue())
+                    E = SM.getFileLoc(Tok.getValue().getEndLoc());
+
+            // Ranges that end before they begin contain no locations
+            if (E.isInvalid() || E < B)
+                continue;
+
+            Ranges.emplace_back(B, E);
+        }
+
+        std::sort(Ranges.begin(), Ranges.end(),
+                  [](const clang::SourceRange &A, const clang::SourceRange &B)
+                  { return A.getBegin() < B.getBegin(); });
+
+        std::vector<clang::SourceRange> Merged;
+        for (auto &&R : Ranges)
+            if (!Merged.empty() && !(Merged.back().getEnd() < R.getBegin()))
+            {
+                if (Merged.back().getEnd() < R.getEnd())
+                    Merged.back().setEnd(R.getEnd());
+            }
+            else
+                Merged.push_back(R);
+        return Merged;
+    }
+
     // Checks if the included file is a globally included file.
     // The first element of the return result if false if not;
     // true otherwise.
     // The second element is the name of the included file.
     std::pair<bool, llvm::StringRef> isGlobalInclude(
         clang::SourceManager &SM,
-        const clang::LangOptions &LO,
         std::pair<const clang::FileEntry *, clang::SourceLocation> &IEL,
         std::set<llvm::StringRef> &LocalIncludes,
-        std::vector<const clang::Decl *> &Decls)
+        const std::vector<clang::SourceRange> &DeclRanges)
     {
         auto FE = IEL.first;
         auto HashLoc = IEL.second;
@@ -354,38 +265,23 @@ if (L.isValid())
 
         // Check that the include does not appear within the range of any
         // declaration in the file
-        if (std::any_of(
-                Decls.begin(),
-                Decls.end(),
-                [&SM, &LO, &HashFLoc](const clang::Decl *D)
-                {
-                    auto B = SM.getFileLoc(D->getBeginLoc());
-                    auto E = SM.getFileLoc(D->getEndLoc());
-
-                    if (B.isInvalid() || E.isInvalid())
-                        return false;
-
-                    // Include the location just after the declaration
-                    // to account for semicolons.
-                    // If the decl does not have semicolon after it,
-                    // that's fine since it would be a non-global
-                    // location anyway
-                    if (auto Tok = clang::Lexer::findNextToken(E, SM, LO))
-                        if (Tok.hasValue())
-                            E = SM.getFileLoc(Tok.getValue().getEndLoc());
-
-                    if (E.isInvalid())
-                        return false;
-
-                    return clang::SourceRange(B, E).fullyContains(HashFLoc);
-                }))
+        auto Next = std::upper_bound(
+            DeclRanges.begin(),
+            DeclRanges.end(),
+            HashFLoc,
+            [](clang::SourceLocation L, const clang::SourceRange &R)
+            { return L < R.getBegin(); });
+        if (Next != DeclRanges.begin() &&
+            std::prev(Next)->fullyContains(HashFLoc))
             return {false, IncludedFileRealpath};
 
         // Success
         return {true, IncludedFileRealpath};
     }
 
-    Cpp2CASTConsumer::Cpp2CASTConsumer(clang::CompilerInstance &CI)
+    Cpp2CASTConsumer::Cpp2CASTConsumer(clang::CompilerInstance &CI,
+                                       const cpp2c::Cpp2COptions &Options)
+        : Options(Options)
     {
         clang::Preprocessor &PP = CI.getPreprocessor();
         clang::ASTContext &Ctx = CI.getASTContext();
@@ -397,6 +293,11 @@ if (L.isValid())
         PP.addPPCallbacks(std::unique_ptr<cpp2c::MacroForest>(MF));
         PP.addPPCallbacks(std::unique_ptr<cpp2c::IncludeCollector>(IC));
         PP.addPPCallbacks(std::unique_ptr<cpp2c::DefinitionInfoCollector>(DC));
+
+        // The token collector must see every token from the start of
+        // preprocessing
+        if (Options.AlignByTokens)
+            Tokens = std::make_unique<clang::syntax::TokenCollector>(PP);
     }
 
     struct ArgInfo
@@ -422,6 +323,14 @@ if (L.isValid())
         auto &SM = Ctx.getSourceManager();
         auto &LO = Ctx.getLangOpts();
 
+        // Returns true if any of the given groups of properties are computed
+        auto Computes = [this](unsigned Groups)
+        { return (Options.PropertyGroups & Groups) != 0; };
+        const unsigned Semantic = Cpp2COptions::Scoping |
+                                  Cpp2COptions::Typing |
+                                  Cpp2COptions::CallingConvention |
+                                  Cpp2COptions::LanguageSpecific;
+
         // Print definition information
         for (auto &&Entry : DC->MacroNamesDefinitions)
         {
@@ -459,12 +368,48 @@ if (L.isValid())
                 Handler.Decls;
             });
 
+        // Order macro definitions and declarations in the translation unit
+        TranslationUnitOrder Order(SM, DC->MacroNamesDefinitions);
+        // The same types are checked for many Exprs and invocations
+        TypeFactsTable Types(Order);
+        TypeStringCache TypeStrings(Ctx);
+
+        // Index the earliest definition of each macro name, and the earliest
+        // top-level declaration of each identifier, so that checking whether
+        // a name was declared before a macro only takes one lookup
+        llvm::StringMap<unsigned> EarliestMacroDefinitions,
+            EarliestTopLevelDecls;
+        auto RecordEarliest = [](llvm::StringMap<unsigned> &Earliest,
+                                 llvm::StringRef Name,
+                                 unsigned Key)
+        {
+            if (Key == TranslationUnitOrder::NoKey)
+                return;
+            auto Res = Earliest.try_emplace(Name, Key);
+            if (!Res.second && Key < Res.first->second)
+                Res.first->second = Key;
+        };
+        if (Computes(Cpp2COptions::Scoping))
+        {
+            for (auto &&Entry : DC->MacroNamesDefinitions)
+                if (Entry.second)
+                    RecordEarliest(EarliestMacroDefinitions, Entry.first,
+                                   Order.keyOf(Entry.second->getMacroInfo()));
+            for (auto D : TopLevelDecls)
+                if (auto ND = clang::dyn_cast_or_null<clang::NamedDecl>(D))
+                    if (auto II = ND->getIdentifier())
+                        RecordEarliest(EarliestTopLevelDecls, II->getName(),
+                                       Order.keyOf(D->getBeginLoc()));
+        }
+
         // Print names of macros inspected by the preprocessor
         for (auto &&Name : DC->InspectedMacroNames)
             print("InspectedByCPP", Name);
         // Print include-directive information
         {
             std::set<llvm::StringRef> LocalIncludes;
+            // Each include is checked against every top-level declaration
+            auto DeclRanges = getMergedDeclRanges(SM, LO, TopLevelDecls);
             for (auto &&IEL : IC->IncludeEntriesLocs)
             {
                 // Facts for includes
@@ -472,8 +417,8 @@ if (L.isValid())
                 std::string IncludeName = "";
 
                 // Check if included at global scope or not
-                auto Res = isGlobalInclude(SM, LO, IEL, LocalIncludes,
-                                           TopLevelDecls);
+                auto Res = isGlobalInclude(SM, IEL, LocalIncludes,
+                                           DeclRanges);
                 if (!Res.first)
                     LocalIncludes.insert(Res.second);
 
@@ -487,146 +432,156 @@ if (L.isValid())
 
 
         // Collect certain sets of AST nodes that will be used for checking
-        // whether properties are satisfied
-
-        // Any reference to a decl
-        std::set<const clang::DeclRefExpr *> AllDeclRefExprs;
+        // whether properties are satisfied, all in a single traversal.
+        // Only collect the sets that the selected properties check.
+        unsigned char Collect = 0;
+        if (Computes(Cpp2COptions::Scoping | Cpp2COptions::LanguageSpecific))
+            Collect |= PropertyNodeSets::DeclRef;
+        if (Computes(Cpp2COptions::Scoping | Cpp2COptions::CallingConvention))
+            Collect |= PropertyNodeSets::SideEffect;
+        if (Computes(Cpp2COptions::Scoping))
+            Collect |= PropertyNodeSets::AddressOf;
+        if (Computes(Cpp2COptions::CallingConvention))
+            Collect |= PropertyNodeSets::Conditional;
+        if (Computes(Cpp2COptions::Scoping | Cpp2COptions::Typing))
+            Collect |= PropertyNodeSets::LocallyTyped;
+        // Only the semantic properties read the numbering and the node sets,
+        // so neither is built if only syntactic properties are computed
+        std::optional<StmtNumbering> Numbering;
+        std::optional<PropertyNodeSets> Nodes;
+        if (Computes(Semantic))
         {
-            MatchFinder Finder;
-            auto Matcher = declRefExpr(
-                               unless(
-                                   anyOf(
-                                       implicitCastExpr(),
-                                       implicitValueInitExpr())))
-                               .bind("root");
-            StmtCollectorMatchHandler Handler;
-            Finder.addMatcher(Matcher, &Handler);
-            Finder.matchAST(Ctx);
-            for (auto &&ST : Handler.Stmts)
-                AllDeclRefExprs.insert(clang::dyn_cast<clang::DeclRefExpr>(ST));
+            Numbering.emplace(Ctx);
+            Nodes.emplace(Ctx, *Numbering,
+                          [&Types](const clang::Type *T)
+                          { return hasLocalType(T, Types); },
+                          Collect,
+                          Computes(Cpp2COptions::LanguageSpecific));
         }
 
         // Any reference to a decl declared at a local scope
         // FIXME: Are there more types of decls we should be accounting for?
         // Types, perhaps?
-        std::set<const clang::DeclRefExpr *> DeclRefExprsOfLocallyDefinedDecls;
+        std::vector<const clang::DeclRefExpr *> DeclRefExprsOfLocallyDefinedDecls;
+        if (Nodes)
         {
-            for (auto &&DRE : AllDeclRefExprs)
+            for (auto &&DRE : Nodes->AllDeclRefExprs)
             {
                 auto D = DRE->getDecl();
                 if (auto VD = clang::dyn_cast<clang::VarDecl>(D))
                     if (VD->hasLocalStorage())
-                        DeclRefExprsOfLocallyDefinedDecls.insert(DRE);
+                        DeclRefExprsOfLocallyDefinedDecls.push_back(DRE);
             }
         }
 
-        // Any expr with side-effects
-        // Binary assignment expressions, Pre/Post Inc/Dec
-        std::set<const clang::Expr *> SideEffectExprs;
+        // The side-effect and address-of exprs keyed by the exprs they
+        // modify or take the address of, so that properties can look up the
+        // operators applied to the nodes under or above an invocation
+        // instead of scanning every operator in the translation unit
+        llvm::DenseMap<const clang::Stmt *, std::vector<const clang::Expr *>>
+            SideEffectExprsByLHS,
+            SideEffectExprsBySkippedLHS;
+        llvm::DenseMap<const clang::Stmt *,
+                       std::vector<const clang::UnaryOperator *>>
+            AddressOfExprsBySkippedOperand;
+        if (Computes(Cpp2COptions::Scoping))
         {
-            MatchFinder Finder;
-            auto Matcher = expr(
-                               allOf(
-                                   unless(
-                                       anyOf(
-                                           implicitCastExpr(),
-                                           implicitValueInitExpr())),
-                                   anyOf(
-                                       binaryOperator(
-                                           isAssignmentOperator()),
-                                       unaryOperator(
-                                           anyOf(
-                                               hasOperatorName("++"),
-                                               hasOperatorName("--"))))))
-                               .bind("root");
-            StmtCollectorMatchHandler Handler;
-            Finder.addMatcher(Matcher, &Handler);
-            Finder.matchAST(Ctx);
-            for (auto &&ST : Handler.Stmts)
-                SideEffectExprs.insert(clang::dyn_cast<clang::Expr>(ST));
-        }
-
-        // Any expr that is the modified part of an expression with side-effects
-        std::set<clang::Expr *> SideEffectExprsLHSs;
-        {
-            for (auto &&E : SideEffectExprs)
+            for (auto &&E : Nodes->SideEffectExprs)
             {
+                clang::Expr *LHS = nullptr;
                 if (auto B = clang::dyn_cast<clang::BinaryOperator>(E))
-                    SideEffectExprsLHSs.insert(B->getLHS());
+                    LHS = B->getLHS();
                 else if (auto U = clang::dyn_cast<clang::UnaryOperator>(E))
-                    SideEffectExprsLHSs.insert(U->getSubExpr());
+                    LHS = U->getSubExpr();
+                if (LHS)
+                    SideEffectExprsByLHS[LHS].push_back(E);
+                if (auto Skipped = skipImplicitAndParens(LHS))
+                    SideEffectExprsBySkippedLHS[Skipped].push_back(E);
             }
+            for (auto &&U : Nodes->AddressOfExprs)
+                if (auto Operand = skipImplicitAndParens(U->getSubExpr()))
+                    AddressOfExprsBySkippedOperand[Operand].push_back(U);
         }
 
-        // Any expr that is an address-of expr
-        std::set<const clang::UnaryOperator *> AddressOfExprs;
-        {
-            MatchFinder Finder;
-            auto Matcher = unaryOperator(
-                               allOf(
-                                   unless(
-                                       anyOf(
-                                           implicitCastExpr(),
-                                           implicitValueInitExpr())),
-                                   hasOperatorName("&")))
-                               .bind("root");
-            StmtCollectorMatchHandler Handler;
-            Finder.addMatcher(Matcher, &Handler);
-            Finder.matchAST(Ctx);
-            for (auto &&S : Handler.Stmts)
-                AddressOfExprs.insert(clang::dyn_cast<clang::UnaryOperator>(S));
-        }
+        // Preprocessing is done, so every expansion's descendants are known
+        MF->aggregateDescendants(Order);
 
-        // Any expr that is the operand of an expression with short-circuiting.
-        // ConditionalOperator, LogicalAnd, LogicalOr
-        std::set<const clang::Expr *> ConditionalExprs;
+        // Align all top-level invocations with the AST up front, looking up
+        // the nodes under each invocation in an index of the AST
+        std::vector<MacroExpansionNode *> TopLevelExpansions;
+        for (auto Exp : MF->Expansions)
+            if (Exp->Depth == 0 && !Exp->InMacroArg)
+                TopLevelExpansions.push_back(Exp);
+        // Either index the entire translation unit, or only the top-level
+        // declarations that top-level invocations appear in
+        std::vector<clang::Decl *> IndexScope;
+        if (Options.AlignWithinEnclosingDecls)
         {
-            MatchFinder Finder;
-            auto Matcher = expr(
-                               allOf(
-                                   unless(
-                                       anyOf(
-                                           implicitCastExpr(),
-                                           implicitValueInitExpr())),
-                                   anyOf(
-                                       conditionalOperator(),
-                                       binaryOperator(
-                                           anyOf(
-                                               hasOperatorName("&&"),
-                                               hasOperatorName("||"))))))
-                               .bind("root");
-            StmtCollectorMatchHandler Handler;
-            Finder.addMatcher(Matcher, &Handler);
-            Finder.matchAST(Ctx);
-            for (auto &&ST : Handler.Stmts)
-                if (auto E = clang::dyn_cast<clang::Expr>(ST))
-                    ConditionalExprs.insert(E);
+            std::vector<clang::SourceRange> Ranges;
+            for (auto Exp : TopLevelExpansions)
+                Ranges.push_back(Exp->SpellingRange);
+            IndexScope = findTopLevelDeclsIntersecting(Ranges, Ctx);
         }
-
-        // Any expr with a type defined at a local scope
-        std::set<const clang::Expr *> ExprsWithLocallyDefinedTypes;
+        else
+            IndexScope.push_back(Ctx.getTranslationUnitDecl());
+
+        // Expansions are aligned and evaluated on a pool of worker threads
+        // if the user asked for more than one job
+        std::unique_ptr<llvm::ThreadPool> Pool;
+        if (Options.Jobs != 1)
+            Pool = std::make_unique<llvm::ThreadPool>(
+                llvm::hardware_concurrency(Options.Jobs));
+        ASTNodeIndex Index(Ctx, IndexScope);
+        // Body and argument alignment look up many of the same locations
+        SourceLocationCache Locations(Ctx.getSourceManager());
+        AlignmentContext BodyContext(Ctx, Locations),
+            ArgumentContext(Ctx, Locations);
+        BodyContext.Tiered = Options.TieredAlignment;
+        BodyContext.ExpansionLocs = &MF->LocTable;
+        if (Tokens)
         {
-            MatchFinder Finder;
-            auto Matcher = expr(
-                               unless(
-                                   anyOf(
-                                       implicitCastExpr(),
-                                       implicitValueInitExpr())))
-                               .bind("root");
-            StmtCollectorMatchHandler Handler;
-            Finder.addMatcher(Matcher, &Handler);
-            Finder.matchAST(Ctx);
-            for (auto &&ST : Handler.Stmts)
-            {
-                auto E = clang::dyn_cast<clang::Expr>(ST);
-                auto QT = E->getType();
-                if (hasLocalType(QT.getTypePtrOrNull(), Ctx))
-                    ExprsWithLocallyDefinedTypes.insert(E);
-            }
+            auto TB = std::move(*Tokens).consume();
+            cpp2c::findAlignedASTNodesForExpansionsByTokens(
+                TopLevelExpansions, BodyContext, Index, TB);
         }
+        else
+            cpp2c::findAlignedASTNodesForExpansions(TopLevelExpansions,
+                                                    BodyContext, Index,
+                                                    Pool.get());
+        cpp2c::findAlignedASTNodesForArguments(TopLevelExpansions,
+                                               ArgumentContext, Index,
+                                               Pool.get());
+        // Report these separately from the invocations on stdout
+        if (Options.TieredAlignment && !Tokens)
+            llvm::errs() << "Tiered alignment: "
+                         << BodyContext.AlignedByStmtTier
+                         << " invocations aligned from Stmts alone, "
+                         << BodyContext.AlignedByAllTiers
+                         << " needed Decls and TypeLocs\n";
+        debug("Location cache",
+              std::to_string(Locations.Hits) + " hits",
+              std::to_string(Locations.Misses) + " misses");
+
+        // Record which invocation, and which part of it, each Stmt was
+        // expanded from, now that they have all been aligned
+        std::optional<StmtOriginTable> Origins;
+        if (Numbering)
+            Origins.emplace(*Numbering, TopLevelExpansions);
+
+        // Evaluating an expansion only reads the AST, except for some
+        // SourceManager and ASTContext queries that fill in caches (line
+        // tables, translation unit order, type nodes, and constant
+        // evaluation). These are serialized with this mutex.
+        std::mutex ASTMutex;
+        auto WithASTLock = [&ASTMutex](auto F)
+        {
+            std::lock_guard<std::mutex> Lock(ASTMutex);
+            return F();
+        };
 
-        // Print macro expansion information
-        for (auto Exp : MF->Expansions)
+        // Computes the properties of the given expansion, and returns the
+        // line of macro expansion information to print for it
+        auto EvaluateExpansion = [&](MacroExpansionNode *Exp) -> std::string
         {
             assert(Exp);
             assert(Exp->MI);
@@ -647,57 +602,57 @@ if (L.isValid())
 
             // Integer properties
             int
-                InvocationDepth,
-                NumASTRoots,
-                NumArguments;
+                InvocationDepth = 0,
+                NumASTRoots = 0,
+                NumArguments = 0;
 
             // Boolean properties
             bool
-                HasStringification,
-                HasTokenPasting,
-                HasAlignedArguments,
-                HasSameNameAsOtherDeclaration,
-
-                IsExpansionControlFlowStmt,
-
-                DoesBodyReferenceMacroDefinedAfterMacro,
-                DoesBodyReferenceDeclDeclaredAfterMacro,
-                DoesBodyContainDeclRefExpr,
-                DoesSubexpressionExpandedFromBodyHaveLocalType,
-                DoesSubexpressionExpandedFromBodyHaveTypeDefinedAfterMacro,
-
-                DoesAnyArgumentHaveSideEffects,
-                DoesAnyArgumentContainDeclRefExpr,
-
-                IsHygienic,
-                IsDefinitionLocationValid,
-                IsInvocationLocationValid,
-                IsObjectLike,
-                IsInvokedInMacroArgument,
-                IsNamePresentInCPPConditional,
-                IsExpansionICE,
-
-                IsExpansionTypeNull,
-                IsExpansionTypeAnonymous,
-                IsExpansionTypeLocalType,
-                IsExpansionTypeDefinedAfterMacro,
-                IsExpansionTypeVoid,
-
-                IsAnyArgumentTypeNull,
-                IsAnyArgumentTypeAnonymous,
-                IsAnyArgumentTypeLocalType,
-                IsAnyArgumentTypeDefinedAfterMacro,
-                IsAnyArgumentTypeVoid,
-
-                IsInvokedWhereModifiableValueRequired,
-                IsInvokedWhereAddressableValueRequired,
-                IsInvokedWhereICERequired,
-
-                IsAnyArgumentExpandedWhereModifiableValueRequired,
-                IsAnyArgumentExpandedWhereAddressableValueRequired,
-                IsAnyArgumentConditionallyEvaluated,
-                IsAnyArgumentNeverExpanded,
-                IsAnyArgumentNotAnExpression;
+                HasStringification = false,
+                HasTokenPasting = false,
+                HasAlignedArguments = false,
+                HasSameNameAsOtherDeclaration = false,
+
+                IsExpansionControlFlowStmt = false,
+
+                DoesBodyReferenceMacroDefinedAfterMacro = false,
+                DoesBodyReferenceDeclDeclaredAfterMacro = false,
+                DoesBodyContainDeclRefExpr = false,
+                DoesSubexpressionExpandedFromBodyHaveLocalType = false,
+                DoesSubexpressionExpandedFromBodyHaveTypeDefinedAfterMacro = false,
+
+                DoesAnyArgumentHaveSideEffects = false,
+                DoesAnyArgumentContainDeclRefExpr = false,
+
+                IsHygienic = false,
+                IsDefinitionLocationValid = false,
+                IsInvocationLocationValid = false,
+                IsObjectLike = false,
+                IsInvokedInMacroArgument = false,
+                IsNamePresentInCPPConditional = false,
+                IsExpansionICE = false,
+
+                IsExpansionTypeNull = false,
+                IsExpansionTypeAnonymous = false,
+                IsExpansionTypeLocalType = false,
+                IsExpansionTypeDefinedAfterMacro = false,
+                IsExpansionTypeVoid = false,
+
+                IsAnyArgumentTypeNull = false,
+                IsAnyArgumentTypeAnonymous = false,
+                IsAnyArgumentTypeLocalType = false,
+                IsAnyArgumentTypeDefinedAfterMacro = false,
+                IsAnyArgumentTypeVoid = false,
+
+                IsInvokedWhereModifiableValueRequired = false,
+                IsInvokedWhereAddressableValueRequired = false,
+                IsInvokedWhereICERequired = false,
+
+                IsAnyArgumentExpandedWhereModifiableValueRequired = false,
+                IsAnyArgumentExpandedWhereAddressableValueRequired = false,
+                IsAnyArgumentConditionallyEvaluated = false,
+                IsAnyArgumentNeverExpanded = false,
+                IsAnyArgumentNotAnExpression = false;
 
             Name = Exp->Name.str();
             InvocationDepth = Exp->Depth;
@@ -705,48 +660,40 @@ if (L.isValid())
             HasStringification = Exp->HasStringification;
             HasTokenPasting = Exp->HasTokenPasting;
 
+            // The following location queries all go through the
+            // SourceManager's caches
+            std::unique_lock<std::mutex> Lock(ASTMutex);
+
+            auto DefKey = Order.keyOf(Exp->MI);
+            bool Scoping = Computes(Cpp2COptions::Scoping),
+                 Typing = Computes(Cpp2COptions::Typing),
+                 ScopingOrTyping = Scoping || Typing,
+                 CallingConvention =
+                     Computes(Cpp2COptions::CallingConvention),
+                 LanguageSpecific = Computes(Cpp2COptions::LanguageSpecific);
+            auto DeclaredBefore =
+                [DefKey](const llvm::StringMap<unsigned> &Earliest,
+                         llvm::StringRef Name)
+            {
+                auto It = Earliest.find(Name);
+                return It != Earliest.end() &&
+                       TranslationUnitOrder::isBefore(It->second, DefKey);
+            };
+            // The indexes are only built when scoping properties are computed
             HasSameNameAsOtherDeclaration =
                 // First check if any macro defined before this macro has the
                 // same name as any of this macro's parameters
                 std::any_of(
-                    DC->MacroNamesDefinitions.begin(),
-                    DC->MacroNamesDefinitions.end(),
-                    [&SM, &Exp](std::pair<std::string,
-                                          const clang::MacroDirective *>
-                                    Entry)
+                    Exp->Arguments.begin(),
+                    Exp->Arguments.end(),
+                    [&](const MacroExpansionArgument &Arg)
                     {
-                        return SM.isBeforeInTranslationUnit(
-                                   SM.getFileLoc(Entry.second
-                                                     ->getDefinition()
-                                                     .getLocation()),
-                                   SM.getFileLoc(Exp->MI
-                                                     ->getDefinitionLoc())) &&
-                               std::any_of(
-                                   Exp->Arguments.begin(),
-                                   Exp->Arguments.end(),
-                                   [&Entry](MacroExpansionArgument Arg)
-                                   {
-                                       return Arg.Name.str() == Entry.first;
-                                   });
+                        return DeclaredBefore(EarliestMacroDefinitions,
+                                              Arg.Name);
                     }) ||
                 // Also check if any global declarations defined before this macro
                 // have the same name as this macro
-                std::any_of(
-                    TopLevelDecls.begin(),
-                    TopLevelDecls.end(),
-                    [&SM, &Exp](const clang::Decl *D)
-                    {
-                        auto ND = clang::dyn_cast_or_null<clang::NamedDecl>(D);
-                        if (!ND)
-                            return false;
-                        auto II = ND->getIdentifier();
-                        if (!II)
-                            return false;
-                        return II->getName().str() == Exp->Name.str() &&
-                               SM.isBeforeInTranslationUnit(
-                                   SM.getFileLoc(D->getBeginLoc()),
-                                   SM.getFileLoc(Exp->MI->getDefinitionLoc()));
-                    });
+                DeclaredBefore(EarliestTopLevelDecls, Exp->Name);
             IsObjectLike = Exp->MI->isObjectLike();
             IsInvokedInMacroArgument = Exp->InMacroArg;
             IsNamePresentInCPPConditional =
@@ -779,25 +726,19 @@ if (L.isValid())
                 InvocationFilename = tryGetFilename(SM, Exp->SpellingRange.getBegin()).second;
             }
 
-            auto DefLoc = SM.getFileLoc(Exp->MI->getDefinitionLoc());
-
             // Check if any macro this macro invokes were defined after
             // this macro was
-            auto Descendants = Exp->getDescendants();
+            DoesBodyReferenceMacroDefinedAfterMacro =
+                Scoping &&
+                TranslationUnitOrder::isBefore(
+                    DefKey, Exp->LatestDescendantDefinitionKey);
 
-            DoesBodyReferenceMacroDefinedAfterMacro = std::any_of(
-                Descendants.begin(),
-                Descendants.end(),
-                [&SM, &Exp](MacroExpansionNode *Desc)
-                { return SM.isBeforeInTranslationUnit(
-                      SM.getFileLoc(Exp->MI->getDefinitionLoc()),
-                      SM.getFileLoc(Desc->MI->getDefinitionLoc())); });
+            Lock.unlock();
 
             // Next get AST information for top level invocations
             if (Exp->Depth == 0 && !Exp->InMacroArg)
             {
                 debug("Top level invocation: ", Exp->Name.str());
-                cpp2c::findAlignedASTNodesForExpansion(Exp, Ctx);
 
                 //// Print macro info
 
@@ -861,231 +802,207 @@ if (L.isValid())
                     { return Arg.AlignedRoots.size() == Arg.NumExpansions; });
                 debug("Done checking if arguments are all aligned");
 
-                std::set<const clang::Stmt *> StmtsExpandedFromArguments;
-                std::map<std::string, std::set<const clang::Stmt *>> StmtsExpandedFromCertainArguments;
+                // Whether each argument is expanded where a modifiable or
+                // addressable value is required, by argument index
+                std::vector<char>
+                    ArgsExpandedWhereModifiableValueRequired(Exp->Arguments.size(), false),
+                    ArgsExpandedWhereAddressableValueRequired(Exp->Arguments.size(), false);
+
                 // Semantic properties of the macro's arguments
-                std::function<bool(const clang::Stmt *, std::string)> ExpandedFromCertainArgument;
-                if (HasAlignedArguments)
+                if (HasAlignedArguments &&
+                    Computes(Cpp2COptions::Scoping |
+                             Cpp2COptions::CallingConvention |
+                             Cpp2COptions::LanguageSpecific))
                 {
-                    debug("Collecting argument subtrees");
-                    for (auto &&Arg : Exp->Arguments)
-                    {
-                        for (auto &&Root : Arg.AlignedRoots)
-                        {
-                            auto STs = subtrees(Root.ST);
-                            StmtsExpandedFromArguments.insert(STs.begin(), STs.end());
-                            StmtsExpandedFromCertainArguments[Arg.Name.str()].insert(STs.begin(), STs.end());
-                        }
-                    }
-                    debug("Done collecting argument subtrees");
-
                     auto ExpandedFromArgument =
-                        [&StmtsExpandedFromArguments](const clang::Stmt *St)
-                    { return StmtsExpandedFromArguments.find(St) !=
-                             StmtsExpandedFromArguments.end(); };
-
-                    ExpandedFromCertainArgument =
-                        [&StmtsExpandedFromCertainArguments](const clang::Stmt *St, std::string ArgName)
-                    { return StmtsExpandedFromCertainArguments[ArgName].find(St) !=
-                             StmtsExpandedFromCertainArguments[ArgName].end(); };
-
-                    DoesAnyArgumentHaveSideEffects = std::any_of(
-                        SideEffectExprs.begin(),
-                        SideEffectExprs.end(),
-                        ExpandedFromArgument);
-
-                    DoesAnyArgumentContainDeclRefExpr = std::any_of(
-                        AllDeclRefExprs.begin(),
-                        AllDeclRefExprs.end(),
-                        ExpandedFromArgument);
-
-                    IsAnyArgumentExpandedWhereModifiableValueRequired = std::any_of(
-                        SideEffectExprs.begin(),
-                        SideEffectExprs.end(),
-                        [&ExpandedFromArgument](const clang::Expr *E)
-                        {
-                            // Only consider side-effect expressions which were
-                            // not expanded from an argument of the same macro
-                            if (!ExpandedFromArgument(E))
-                            {
-                                clang::Expr *LHS = nullptr;
-                                auto B = clang::dyn_cast<clang::BinaryOperator>(E);
-                                auto U = clang::dyn_cast<clang::UnaryOperator>(E);
-                                if (B)
-                                    LHS = B->getLHS();
-                                else if (U)
-                                    LHS = U->getSubExpr();
-                                LHS = skipImplicitAndParens(LHS);
-                                return ExpandedFromArgument(LHS);
-                            }
-                            return false;
-                        });
+                        [&Origins, Exp](const clang::Stmt *St)
+                    { return Origins->isExpandedFromAnyArgument(St, Exp); };
 
-                    IsAnyArgumentExpandedWhereAddressableValueRequired = std::any_of(
-                        AddressOfExprs.begin(),
-                        AddressOfExprs.end(),
-                        [&ExpandedFromArgument](const clang::UnaryOperator *U)
-                        {
-                            // Only consider address of expressions which were
-                            // not expanded from an argument of the same macro
-                            if (!ExpandedFromArgument(U))
-                            {
-                                auto Operand = U->getSubExpr();
-                                Operand = skipImplicitAndParens(Operand);
-                                return ExpandedFromArgument(Operand);
-                            }
-                            return false;
-                        });
+                    // Check the properties of the arguments in a single walk
+                    // over the Stmts expanded from them
+                    auto CheckArgumentStmt = [&](const clang::Stmt *St)
+                    {
+                        auto Kinds = Nodes->kindsOf(St);
+                        if (CallingConvention &&
+                            (Kinds & PropertyNodeSets::SideEffect))
+                            DoesAnyArgumentHaveSideEffects = true;
+                        if (LanguageSpecific &&
+                            (Kinds & PropertyNodeSets::DeclRef))
+                            DoesAnyArgumentContainDeclRefExpr = true;
+                        if (CallingConvention && isControlFlowStmt(St))
+                            IsExpansionControlFlowStmt = true;
+
+                        // Only consider side-effect and address of
+                        // expressions which were not expanded from an
+                        // argument of the same macro
+                        auto Modifiers = SideEffectExprsBySkippedLHS.find(St);
+                        if (Modifiers != SideEffectExprsBySkippedLHS.end() &&
+                            !std::all_of(Modifiers->second.begin(),
+                                         Modifiers->second.end(),
+                                         ExpandedFromArgument))
+                            IsAnyArgumentExpandedWhereModifiableValueRequired = true;
+
+                        auto AddressOfs = AddressOfExprsBySkippedOperand.find(St);
+                        if (AddressOfs != AddressOfExprsBySkippedOperand.end() &&
+                            !std::all_of(AddressOfs->second.begin(),
+                                         AddressOfs->second.end(),
+                                         ExpandedFromArgument))
+                            IsAnyArgumentExpandedWhereAddressableValueRequired = true;
+
+                        // Attribute the operators applied to this Stmt to the
+                        // argument it was expanded from, unless they were
+                        // expanded from the same argument
+                        auto Origin = Origins->originOf(St);
+                        if (Origin.Expansion != Exp || Origin.ArgIndex == -1)
+                            return;
+                        auto NotExpandedFromSameArgument =
+                            [&Origins, Exp, &Origin](const clang::Stmt *Op)
+                        { return !Origins->isExpandedFromArgument(Op, Exp, Origin.ArgIndex); };
+
+                        if (Modifiers != SideEffectExprsBySkippedLHS.end() &&
+                            std::any_of(Modifiers->second.begin(),
+                                        Modifiers->second.end(),
+                                        NotExpandedFromSameArgument))
+                            ArgsExpandedWhereModifiableValueRequired[Origin.ArgIndex] = true;
+
+                        if (AddressOfs != AddressOfExprsBySkippedOperand.end() &&
+                            std::any_of(AddressOfs->second.begin(),
+                                        AddressOfs->second.end(),
+                                        NotExpandedFromSameArgument))
+                            ArgsExpandedWhereAddressableValueRequired[Origin.ArgIndex] = true;
+                    };
+                    for (auto &&Arg : Exp->Arguments)
+                        for (auto &&Root : Arg.AlignedRoots)
+                            Numbering->forEachInTree(Root.ST, CheckArgumentStmt);
                 }
 
-                std::set<const clang::Stmt *> StmtsExpandedFromBody;
                 // Semantic properties of the macro body
                 if (Exp->AlignedRoot && Exp->AlignedRoot->ST && HasAlignedArguments)
                 {
                     auto ST = Exp->AlignedRoot->ST;
 
-                    debug("Collecting body subtrees");
-                    StmtsExpandedFromBody = subtrees(ST);
-                    // Remove all Stmts which were actually expanded from arguments
-                    for (auto &&St : StmtsExpandedFromArguments)
-                        StmtsExpandedFromBody.erase(St);
-
                     auto ExpandedFromBody =
-                        [&StmtsExpandedFromBody](const clang::Stmt *St)
-                    { return StmtsExpandedFromBody.find(St) !=
-                             StmtsExpandedFromBody.end(); };
-
-                    debug("Checking if any argument is conditionally "
-                            "evaluated in the body of the expansion");
-                    IsAnyArgumentConditionallyEvaluated = std::any_of(
-                        ConditionalExprs.begin(),
-                        ConditionalExprs.end(),
-                        [&ExpandedFromBody,
-                         &StmtsExpandedFromArguments](const clang::Expr *CE)
-                        {
-                            return ExpandedFromBody(CE) && std::any_of(
-                                StmtsExpandedFromArguments.begin(),
-                                StmtsExpandedFromArguments.end(),
-                                [&CE](const clang::Stmt *ArgStmt)
-                                { return inTree(ArgStmt, CE); });
-                        });
-                    debug("Done checking if any argument is conditionally "
-                            "evaluated in the body of the expansion");
-
-                    // NOTE: This may not be correct if the definition of
-                    // of the decl is separate from its declaration.
-                    DoesBodyReferenceDeclDeclaredAfterMacro = std::any_of(
-                        AllDeclRefExprs.begin(),
-                        AllDeclRefExprs.end(),
-                        [&SM,
-                         &DefLoc,
-                         &ExpandedFromBody](const clang::DeclRefExpr *DRE)
-                        {
-                            if (ExpandedFromBody(DRE))
-                            {
-                                auto D = DRE->getDecl();
-                                auto DeclLoc = SM.getFileLoc(D->getLocation());
+                        [&Origins, Exp](const clang::Stmt *St)
+                    { return Origins->isExpandedFromBody(St, Exp); };
+
+                    auto RootRange = WithASTLock(
+                        [&]
+                        { return clang::SourceRange(
+                              SM.getFileLoc(ST->getBeginLoc()),
+                              SM.getFileLoc(ST->getEndLoc())); });
+
+                    // Returns true if any Stmt expanded from an argument lies
+                    // under the given Stmt
+                    auto HasArgumentStmtUnder = [&](const clang::Stmt *St)
+                    {
+                        for (auto &&Arg : Exp->Arguments)
+                            for (auto &&Root : Arg.AlignedRoots)
+                                if (isInTree(
+                                        Root.ST,
+                                        [&](const clang::Stmt *ArgStmt)
+                                        { return inTree(ArgStmt, St, *Numbering); },
+                                        *Numbering))
+                                    return true;
+                        return false;
+                    };
 
-                                return SM.isBeforeInTranslationUnit(DefLoc,
-                                                                    DeclLoc);
-                            }
-                            return false;
-                        });
+                    // Check the properties of the body in a single walk over
+                    // the Stmts under its aligned root
+                    debug("Checking body properties");
+                    IsHygienic = Scoping;
+                    auto CheckBodyStmt = [&](const clang::Stmt *St)
+                    {
+                        if (!ExpandedFromBody(St))
+                            return;
 
-                    DoesBodyContainDeclRefExpr = std::any_of(
-                        AllDeclRefExprs.begin(),
-                        AllDeclRefExprs.end(),
-                        ExpandedFromBody);
-
-                    DoesSubexpressionExpandedFromBodyHaveLocalType = std::any_of(
-                        ExprsWithLocallyDefinedTypes.begin(),
-                        ExprsWithLocallyDefinedTypes.end(),
-                        ExpandedFromBody);
-
-                    DoesSubexpressionExpandedFromBodyHaveTypeDefinedAfterMacro =
-                        std::any_of(
-                            StmtsExpandedFromBody.begin(),
-                            StmtsExpandedFromBody.end(),
-                            [&Ctx, &DefLoc](const clang::Stmt *St)
-                            {
-                                if (auto E = clang::dyn_cast<clang::Expr>(St))
-                                {
-                                    auto QT = E->getType();
-                                    return hasTypeDefinedAfter(QT.getTypePtrOrNull(), Ctx, DefLoc);
-                                }
-                                return false;
-                            });
+                        auto Kinds = Nodes->kindsOf(St);
+                        if (CallingConvention && isControlFlowStmt(St))
+                            IsExpansionControlFlowStmt = true;
+
+                        if ((Kinds & PropertyNodeSets::Conditional) &&
+                            !IsAnyArgumentConditionallyEvaluated)
+                            IsAnyArgumentConditionallyEvaluated =
+                                HasArgumentStmtUnder(St);
 
-                    // We only allow references to declarations declared
-                    // within the macro expansion itself
-                    IsHygienic = std::none_of(
-                        DeclRefExprsOfLocallyDefinedDecls.begin(),
-                        DeclRefExprsOfLocallyDefinedDecls.end(),
-                        [&ST, &SM, &ExpandedFromBody](const clang::DeclRefExpr *DRE)
+                        if (Kinds & PropertyNodeSets::DeclRef)
                         {
-                            // References that don't come from the macro's body
-                            // are fine
-                            if (!ExpandedFromBody(DRE))
-                                return false;
-
-                            auto B = SM.getFileLoc(ST->getBeginLoc());
-                            auto E = SM.getFileLoc(ST->getEndLoc());
-                            auto D = DRE->getDecl();
-                            if (!D)
-                                return false;
-
-                            auto L = SM.getFileLoc(D->getLocation());
+                            DoesBodyContainDeclRefExpr = LanguageSpecific;
+
+                            auto D = clang::cast<clang::DeclRefExpr>(St)->getDecl();
+                            auto DeclLoc = WithASTLock(
+                                [&]
+                                { return SM.getFileLoc(D->getLocation()); });
+
+                            // NOTE: This may not be correct if the definition of
+                            // of the decl is separate from its declaration.
+                            if (Scoping && !DoesBodyReferenceDeclDeclaredAfterMacro)
+                                DoesBodyReferenceDeclDeclaredAfterMacro = WithASTLock(
+                                    [&]
+                                    { return TranslationUnitOrder::isBefore(
+                                          DefKey, Order.keyOf(DeclLoc)); });
+
+                            // We only allow references to declarations declared
+                            // within the macro expansion itself
                             // NOTE: It would be nice if we could instead walk
                             // the AST and check if this decl is under the AST
                             // aligned with this macro.
                             // This should work for now though.
-                            return !clang::SourceRange(B, E).fullyContains(L);
-                        });
+                            if (auto VD = clang::dyn_cast<clang::VarDecl>(D))
+                                if (VD->hasLocalStorage() &&
+                                    !RootRange.fullyContains(DeclLoc))
+                                    IsHygienic = false;
+                        }
 
-                    IsInvokedWhereModifiableValueRequired = std::any_of(
-                        SideEffectExprs.begin(),
-                        SideEffectExprs.end(),
-                        [&ST, &ExpandedFromBody](const clang::Expr *E)
-                        {
-                            // Only consider side-effect expressions which were
-                            // not expanded from the body of the same macro
-                            if (!ExpandedFromBody(E))
-                            {
-                                clang::Expr *LHS = nullptr;
-                                auto B = clang::dyn_cast<clang::BinaryOperator>(E);
-                                auto U = clang::dyn_cast<clang::UnaryOperator>(E);
-                                if (B)
-                                    LHS = B->getLHS();
-                                else if (U)
-                                    LHS = U->getSubExpr();
-                                return inTree(ST, LHS);
-                            }
-                            return false;
-                        });
+                        if (Kinds & PropertyNodeSets::LocallyTyped)
+                            DoesSubexpressionExpandedFromBodyHaveLocalType = true;
 
-                    IsInvokedWhereAddressableValueRequired = std::any_of(
-                        AddressOfExprs.begin(),
-                        AddressOfExprs.end(),
-                        [&ST, &ExpandedFromBody](const clang::UnaryOperator *U)
-                        {
-                            // Only consider address of expressions which were
-                            // not expanded from the body of the same macro
-                            if (!ExpandedFromBody(U))
+                        if (auto E = clang::dyn_cast<clang::Expr>(St))
+                            if (ScopingOrTyping &&
+                                !DoesSubexpressionExpandedFromBodyHaveTypeDefinedAfterMacro)
                             {
-                                auto Operand = U->getSubExpr();
-                                Operand = skipImplicitAndParens(Operand);
-                                return inTree(ST, Operand);
+                                auto QT = E->getType();
+                                DoesSubexpressionExpandedFromBodyHaveTypeDefinedAfterMacro = WithASTLock(
+                                    [&]
+                                    { return hasTypeDefinedAfter(QT.getTypePtrOrNull(), Types, DefKey); });
                             }
-                            return false;
-                        });
+                    };
+                    if (Computes(Semantic))
+                        Numbering->forEachInTree(ST, CheckBodyStmt);
+                    debug("Done checking body properties");
+
+                    // The macro is invoked where a modifiable or addressable
+                    // value is required if an operator which was not
+                    // expanded from its body is applied to an expression
+                    // that the aligned root lies under
+                    if (Scoping)
+                        Numbering->forEachAncestor(
+                            ST,
+                            [&](const clang::Stmt *Up)
+                            {
+                                auto Modifiers = SideEffectExprsByLHS.find(Up);
+                                if (Modifiers != SideEffectExprsByLHS.end() &&
+                                    !std::all_of(Modifiers->second.begin(),
+                                                 Modifiers->second.end(),
+                                                 ExpandedFromBody))
+                                    IsInvokedWhereModifiableValueRequired = true;
+
+                                auto AddressOfs = AddressOfExprsBySkippedOperand.find(Up);
+                                if (AddressOfs != AddressOfExprsBySkippedOperand.end() &&
+                                    !std::all_of(AddressOfs->second.begin(),
+                                                 AddressOfs->second.end(),
+                                                 ExpandedFromBody))
+                                    IsInvokedWhereAddressableValueRequired = true;
+                            });
 
-                    IsInvokedWhereICERequired =
-                        isDescendantOfStmtRequiringICE(Ctx, ST);
+                    if (Nodes)
+                        IsInvokedWhereICERequired =
+                            Nodes->isDescendantOfStmtRequiringICE(ST);
 
                     //// Generate type signature
 
                     // Body type information
-                    TypeSignature = "void";
+                    if (Typing)
+                        TypeSignature = "void";
                     if (auto E = clang::dyn_cast<clang::Expr>(ST))
                     {
                         ASTKind = "Expr";
@@ -1095,22 +1012,31 @@ if (L.isValid())
                         auto T = QT.getTypePtrOrNull();
                         IsExpansionTypeNull = QT.isNull() || T == nullptr;
 
-                        if (T)
+                        if (T && Typing)
                         {
                             IsExpansionTypeVoid = T->isVoidType();
-                            IsExpansionTypeAnonymous = hasAnonymousType(T, Ctx);
-                            IsExpansionTypeLocalType = hasLocalType(T, Ctx);
-                            auto CT = QT.getDesugaredType(Ctx)
-                                          .getUnqualifiedType()
-                                          .getCanonicalType();
-                            TypeSignature = CT.getAsString();
+                            IsExpansionTypeAnonymous = WithASTLock(
+                                [&]
+                                { return hasAnonymousType(T, Types); });
+                            TypeSignature = WithASTLock(
+                                [&]
+                                { return TypeStrings.canonicalStringOf(QT); }).str();
                         }
-                        IsExpansionTypeDefinedAfterMacro =
-                            hasTypeDefinedAfter(QT.getTypePtrOrNull(), Ctx, DefLoc);
+                        if (T && ScopingOrTyping)
+                            IsExpansionTypeLocalType = WithASTLock(
+                                [&]
+                                { return hasLocalType(T, Types); });
+                        if (Scoping)
+                            IsExpansionTypeDefinedAfterMacro = WithASTLock(
+                                [&]
+                                { return hasTypeDefinedAfter(QT.getTypePtrOrNull(), Types, DefKey); });
 
                         // Whether this expression is an integral
                         // constant expression
-                        IsExpansionICE = E->isIntegerConstantExpr(Ctx);
+                        if (LanguageSpecific)
+                            IsExpansionICE = WithASTLock(
+                                [&]
+                                { return E->isIntegerConstantExpr(Ctx); });
 
                         IsLValue = E->isLValue();
                     }
@@ -1122,7 +1048,7 @@ if (L.isValid())
 
                     ReturnType = TypeSignature;
 
-                    if (Exp->MI->isFunctionLike() &&
+                    if (Typing && Exp->MI->isFunctionLike() &&
                         (ASTKind == "Stmt" || ASTKind == "Expr"))
                         TypeSignature += "(";
                     debug("Iterating arguments");
@@ -1133,12 +1059,13 @@ if (L.isValid())
                             .Name = Arg.Name.str(),
                             .ASTKind = "<Null>",
                             .Type = "<Null>",
-                            .ActualArgLocBegin = InvocationFilename + ":" + tryGetLineColumn(SM, Arg.TokensWithTail.front().getLocation()).second,
-                            .ActualArgLocEnd = InvocationFilename + ":" + tryGetLineColumn(SM, Arg.TokensWithTail.back().getEndLoc()).second
+                            .ActualArgLocBegin = InvocationFilename + ":" + WithASTLock([&] { return tryGetLineColumn(SM, Arg.TokensWithTail.front().getLocation()).second; }),
+                            .ActualArgLocEnd = InvocationFilename + ":" + WithASTLock([&] { return tryGetLineColumn(SM, Arg.TokensWithTail.back().getEndLoc()).second; })
                         });
 
-                        if (ArgNum != 0)
+                        if (Typing && ArgNum != 0)
                             TypeSignature += ", ";
+                        int ArgIndex = ArgNum;
                         ArgNum += 1;
 
                         IsAnyArgumentNeverExpanded = Arg.AlignedRoots.empty();
@@ -1156,97 +1083,48 @@ if (L.isValid())
                         if (!E)
                             continue;
 
-                        std::string ArgTypeStr = "<Null>";
+                        llvm::StringRef ArgTypeStr = "<Null>";
 
                         // Type information about arguments
                         auto QT = E->getType();
                         auto T = QT.getTypePtrOrNull();
                         IsAnyArgumentTypeNull |= QT.isNull() || T == nullptr;
 
-                        if (T)
+                        if (T && Typing)
                         {
                             IsAnyArgumentTypeVoid = T->isVoidType();
-                            IsAnyArgumentTypeAnonymous = hasAnonymousType(T, Ctx);
-                            IsAnyArgumentTypeLocalType = hasLocalType(T, Ctx);
-                            auto CT = QT.getDesugaredType(Ctx)
-                                          .getUnqualifiedType()
-                                          .getCanonicalType();
-                            ArgTypeStr = CT.getAsString();
+                            IsAnyArgumentTypeAnonymous = WithASTLock(
+                                [&]
+                                { return hasAnonymousType(T, Types); });
+                            ArgTypeStr = WithASTLock(
+                                [&]
+                                { return TypeStrings.canonicalStringOf(QT); });
+                        }
+                        if (T && ScopingOrTyping)
+                            IsAnyArgumentTypeLocalType = WithASTLock(
+                                [&]
+                                { return hasLocalType(T, Types); });
+                        if (ScopingOrTyping)
+                            IsAnyArgumentTypeDefinedAfterMacro |= WithASTLock(
+                                [&]
+                                { return hasTypeDefinedAfter(QT.getTypePtrOrNull(), Types, DefKey); });
+
+                        if (Typing)
+                        {
+                            TypeSignature += ArgTypeStr;
+                            Args.back().Type = ArgTypeStr.str();
                         }
-                        IsAnyArgumentTypeDefinedAfterMacro |=
-                            hasTypeDefinedAfter(QT.getTypePtrOrNull(), Ctx, DefLoc);
-
-                        TypeSignature += ArgTypeStr;
-
-                        Args.back().Type = ArgTypeStr;
-
-                        bool IsThisArgumentExpandedWhereModifiableValueRequired = std::any_of(
-                            SideEffectExprs.begin(),
-                            SideEffectExprs.end(),
-                            [&ExpandedFromCertainArgument, &Arg](const clang::Expr *E)
-                            {
-                                // Only consider side-effect expressions which were
-                                // not expanded from an argument of the same macro
-                                if (!ExpandedFromCertainArgument(E, Arg.Name.str()))
-                                {
-                                    clang::Expr *LHS = nullptr;
-                                    auto B = clang::dyn_cast<clang::BinaryOperator>(E);
-                                    auto U = clang::dyn_cast<clang::UnaryOperator>(E);
-                                    if (B)
-                                        LHS = B->getLHS();
-                                    else if (U)
-                                        LHS = U->getSubExpr();
-                                    LHS = skipImplicitAndParens(LHS);
-                                    return ExpandedFromCertainArgument(LHS, Arg.Name.str());
-                                }
-                                return false;
-                            }
-                        );
-
-                        bool IsThisArgumentExpandedWhereAddressableValueRequired = std::any_of(
-                            AddressOfExprs.begin(),
-                            AddressOfExprs.end(),
-                            [&ExpandedFromCertainArgument, &Arg](const clang::UnaryOperator *U)
-                            {
-                                // Only consider address of expressions which were
-                                // not expanded from an argument of the same macro
-                                if (!ExpandedFromCertainArgument(U, Arg.Name.str()))
-                                {
-                                    auto Operand = U->getSubExpr();
-                                    Operand = skipImplicitAndParens(Operand);
-                                    return ExpandedFromCertainArgument(Operand, Arg.Name.str());
-                                }
-                                return false;
-                            }
-                        );
 
                         Args.back().IsLValue = E->isLValue();
                         Args.back().ASTKind = "Expr";
-                        Args.back().ExpandedWhereModifiableValueRequired = IsThisArgumentExpandedWhereModifiableValueRequired;
-                        Args.back().ExpandedWhereAddressableValueRequired = IsThisArgumentExpandedWhereAddressableValueRequired;
+                        Args.back().ExpandedWhereModifiableValueRequired = ArgsExpandedWhereModifiableValueRequired[ArgIndex];
+                        Args.back().ExpandedWhereAddressableValueRequired = ArgsExpandedWhereAddressableValueRequired[ArgIndex];
                     }
                     debug("Finished iterating arguments");
-                    if (Exp->MI->isFunctionLike() &&
+                    if (Typing && Exp->MI->isFunctionLike() &&
                         (ASTKind == "Stmt" || ASTKind == "Expr"))
                         TypeSignature += ")";
                 }
-
-                // Set of all Stmts expanded from macro
-                std::set<const clang::Stmt *> AllStmtsExpandedFromMacro =
-                    StmtsExpandedFromBody;
-                AllStmtsExpandedFromMacro.insert(StmtsExpandedFromArguments.begin(),
-                                                 StmtsExpandedFromArguments.end());
-
-                IsExpansionControlFlowStmt = std::any_of(
-                    AllStmtsExpandedFromMacro.begin(),
-                    AllStmtsExpandedFromMacro.end(),
-                    [](const clang::Stmt *St)
-                    {
-                        return llvm::isa_and_nonnull<clang::ReturnStmt>(St) ||
-                               llvm::isa_and_nonnull<clang::ContinueStmt>(St) ||
-                               llvm::isa_and_nonnull<clang::BreakStmt>(St) ||
-                               llvm::isa_and_nonnull<clang::GotoStmt>(St);
-                    });
             }
 
             // Create a JSON object
@@ -1320,15 +1198,36 @@ if (L.isValid())
 
             #undef ADD_PROPERTY
 
-            llvm::outs() << "Invocation\t";
+            std::string Line = "Invocation\t";
 
             // Output the JSON object
             if (Debug) {
-                llvm::outs() << properties.dump(4) << "\n"; // Pretty print with 4 spaces indentation
+                Line += properties.dump(4) + "\n"; // Pretty print with 4 spaces indentation
             } else {
-                llvm::outs() << properties.dump() << "\n"; // Compact print
+                Line += properties.dump() + "\n"; // Compact print
             }
+            return Line;
+        };
+
+        // Print macro expansion information
+        if (Pool)
+        {
+            // Evaluate expansions in parallel, but print them in the same
+            // order as when evaluating them sequentially
+            std::vector<std::string> Lines(MF->Expansions.size());
+            parallelFor(Pool.get(), MF->Expansions.size(),
+                        [&](unsigned I)
+                        { Lines[I] = EvaluateExpansion(MF->Expansions[I]); });
+            for (auto &&Line : Lines)
+                llvm::outs() << Line;
         }
+        else
+            for (auto Exp : MF->Expansions)
+                llvm::outs() << EvaluateExpansion(Exp);
+
+        debug("Type facts",
+              std::to_string(Types.Hits) + " hits",
+              std::to_string(Types.Misses) + " misses");
 
         // Only delete top level expansions since deconstructor deletes
         // nested expansions
@@ -1,11 +1,15 @@
 #pragma once
 
+#include "Cpp2COptions.hh"
 #include "MacroForest.hh"
 #include "IncludeCollector.hh"
 #include "DefinitionInfoCollector.hh"
 
 #include "clang/Frontend/ASTConsumers.h"
 #include "clang/Frontend/CompilerInstance.h"
+#include "clang/Tooling/Syntax/Tokens.h"
+
+#include <memory>
 
 namespace cpp2c
 {
@@ -15,9 +19,14 @@ namespace cpp2c
         cpp2c::MacroForest *MF;
         cpp2c::IncludeCollector *IC;
         cpp2c::DefinitionInfoCollector *DC;
+        cpp2c::Cpp2COptions Options;
+        // Records the tokens of the translation unit for the token-based
+        // alignment backend, if it is used
+        std::unique_ptr<clang::syntax::TokenCollector> Tokens;
 
     public:
-        Cpp2CASTConsumer(clang::CompilerInstance &CI);
+        Cpp2CASTConsumer(clang::CompilerInstance &CI,
+                         const cpp2c::Cpp2COptions &Options);
         void HandleTranslationUnit(clang::ASTContext &Ctx) override;
     };
 
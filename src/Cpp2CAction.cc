@@ -1,18 +1,77 @@
 #include "Cpp2CAction.hh"
 #include "Cpp2CASTConsumer.hh"
 
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSwitch.h"
+
 namespace cpp2c
 {
     std::unique_ptr<clang::ASTConsumer>
     Cpp2CAction::CreateASTConsumer(clang::CompilerInstance &CI,
                                    llvm::StringRef InFile)
     {
-        return std::make_unique<cpp2c::Cpp2CASTConsumer>(CI);
+        return std::make_unique<cpp2c::Cpp2CASTConsumer>(CI, Options);
+    }
+
+    // Parses a comma-separated list of property groups into a mask of
+    // Cpp2COptions::PropertyGroup flags.
+    // Returns false if any group is not recognized.
+    static bool parsePropertyGroups(llvm::StringRef Value, unsigned &Groups)
+    {
+        Groups = 0;
+        llvm::SmallVector<llvm::StringRef, 5> Names;
+        Value.split(Names, ',');
+        for (auto &&Name : Names)
+        {
+            auto Group =
+                llvm::StringSwitch<unsigned>(Name)
+                    .Case("syntactic", Cpp2COptions::Syntactic)
+                    .Case("scoping", Cpp2COptions::Scoping)
+                    .Case("typing", Cpp2COptions::Typing)
+                    .Case("calling-convention",
+                          Cpp2COptions::CallingConvention)
+                    .Case("language-specific",
+                          Cpp2COptions::LanguageSpecific)
+                    .Case("all", Cpp2COptions::AllPropertyGroups)
+                    .Default(0);
+            if (!Group)
+                return false;
+            Groups |= Group;
+        }
+        return true;
     }
 
     bool Cpp2CAction::ParseArgs(const clang::CompilerInstance &CI,
                                 const std::vector<std::string> &arg)
     {
+        auto &DE = CI.getDiagnostics();
+        for (auto &&A : arg)
+        {
+            auto KV = llvm::StringRef(A).split('=');
+            auto Key = KV.first, Value = KV.second;
+            unsigned Jobs, Groups;
+
+            if (Key == "align-scope" && (Value == "tu" || Value == "decl"))
+                Options.AlignWithinEnclosingDecls = (Value == "decl");
+            else if (Key == "jobs" && !Value.getAsInteger(10, Jobs))
+                Options.Jobs = Jobs;
+            else if (Key == "align-tiers" &&
+                     (Value == "all" || Value == "tiered"))
+                Options.TieredAlignment = (Value == "tiered");
+            else if (Key == "alignment-backend" &&
+                     (Value == "locations" || Value == "tokens"))
+                Options.AlignByTokens = (Value == "tokens");
+            else if (Key == "properties" && parsePropertyGroups(Value, Groups))
+                Options.PropertyGroups = Groups;
+            else
+            {
+                auto ID = DE.getCustomDiagID(
+                    clang::DiagnosticsEngine::Error,
+                    "invalid argument to macro-types plugin: '%0'");
+                DE.Report(ID) << A;
+                return false;
+            }
+        }
         return true;
     }
 
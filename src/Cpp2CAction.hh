@@ -1,11 +1,15 @@
 #pragma once
 
+#include "Cpp2COptions.hh"
+
 #include <clang/Frontend/FrontendPluginRegistry.h>
 
 namespace cpp2c
 {
     class Cpp2CAction : public clang::PluginASTAction
     {
+    private:
+        cpp2c::Cpp2COptions Options;
 
     protected:
         std::unique_ptr<clang::ASTConsumer>
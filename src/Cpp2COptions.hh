@@ -0,0 +1,46 @@
+#pragma once
+
+namespace cpp2c
+{
+    // Options controlling the analysis, set through the plugin's arguments
+    // (-fplugin-arg-macro-types-<option>)
+    struct Cpp2COptions
+    {
+        // Only align invocations with the AST nodes under the top-level
+        // declarations that enclose them, instead of indexing the entire
+        // translation unit (align-scope=decl)
+        bool AlignWithinEnclosingDecls = false;
+
+        // The number of threads to align and evaluate invocations on.
+        // 1 evaluates them on the main thread, and 0 uses one thread per
+        // hardware thread (jobs=N)
+        unsigned Jobs = 1;
+
+        // Stop looking for the nodes aligned with an invocation's body
+        // once the aligned Stmts rule out any aligned Decls and TypeLocs,
+        // and report how often this happens (align-tiers=tiered)
+        bool TieredAlignment = false;
+
+        // Align invocations' bodies by comparing the spans of tokens that
+        // invocations and AST nodes cover in the expanded token stream,
+        // instead of by walking each node's macro locations
+        // (alignment-backend=tokens)
+        bool AlignByTokens = false;
+
+        // The groups of properties to compute for each invocation, which
+        // match the categories in evaluation/predicates/property_categories.py.
+        // The syntactic facts that the other groups depend on are always
+        // computed, and properties in groups that are not selected keep
+        // their default values (properties=<group>,...)
+        enum PropertyGroup : unsigned
+        {
+            Syntactic = 1 << 0,
+            Scoping = 1 << 1,
+            Typing = 1 << 2,
+            CallingConvention = 1 << 3,
+            LanguageSpecific = 1 << 4,
+            AllPropertyGroups = (1 << 5) - 1,
+        };
+        unsigned PropertyGroups = AllPropertyGroups;
+    };
+} // namespace cpp2c
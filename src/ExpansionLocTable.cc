@@ -0,0 +1,112 @@
+#include "ExpansionLocTable.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace cpp2c
+{
+    void ExpansionLocTable::beginExpansion(const clang::SourceManager &SM)
+    {
+        if (LastRegionOpen)
+        {
+            Regions.back().End = SM.getNextLocalOffset();
+            LastRegionOpen = false;
+        }
+    }
+
+    void ExpansionLocTable::endExpansion(const clang::SourceManager &SM,
+                                         MacroExpansionNode *Exp)
+    {
+        // Expansions in this expansion's arguments were expanded during
+        // its callback, so close the region of the last of them first
+        beginExpansion(SM);
+        Regions.push_back({SM.getNextLocalOffset(),
+                           std::numeric_limits<unsigned>::max(),
+                           Exp});
+        LastRegionOpen = true;
+    }
+
+    MacroExpansionNode *ExpansionLocTable::ownerOf(unsigned Offset) const
+    {
+        auto It = std::upper_bound(
+            Regions.begin(), Regions.end(), Offset,
+            [](unsigned O, const Region &R)
+            { return O < R.Begin; });
+        if (It == Regions.begin())
+            return nullptr;
+        --It;
+        return Offset < It->End ? It->Expansion : nullptr;
+    }
+
+    int ExpansionLocTable::argumentIndexOf(const clang::SourceManager &SM,
+                                           const MacroExpansionNode *Exp,
+                                           clang::SourceLocation L)
+    {
+        while (L.isValid())
+        {
+            for (unsigned I = 0; I < Exp->Arguments.size(); I++)
+            {
+                auto R = Exp->Arguments[I].UnexpandedRange;
+                if (R.isValid() &&
+                    SM.getFileID(R.getBegin()) == SM.getFileID(L) &&
+                    !(L < R.getBegin()) && !(R.getEnd() < L))
+                    return I;
+            }
+            // The location may have come from a macro invoked in the
+            // argument, in which case that macro's name is in the argument
+            if (!L.isMacroID())
+                break;
+            L = SM.getImmediateExpansionRange(L).getBegin();
+        }
+        return -1;
+    }
+
+    ExpansionLocTable::Origin ExpansionLocTable::originOf(
+        const clang::SourceManager &SM,
+        clang::SourceLocation L) const
+    {
+        if (!L.isMacroID())
+            return {};
+
+        auto &Entry = SM.getSLocEntry(SM.getFileID(L));
+        auto &Info = Entry.getExpansion();
+
+        if (Info.isMacroArgExpansion())
+        {
+            // Argument entries record where in the body of the expansion
+            // the argument was substituted
+            auto Body = originOf(SM, Info.getExpansionLocStart());
+            if (!Body.Expansion || Body.ArgIndex != -1)
+                return {};
+            Body.ArgIndex = argumentIndexOf(SM, Body.Expansion,
+                                            Info.getSpellingLoc());
+            if (Body.ArgIndex == -1)
+                return {};
+            return Body;
+        }
+
+        // Body entries record the location of the name of the macro they
+        // are an expansion of, which lets us check that an entry was not
+        // created later on by some other expansion
+        auto Exp = ownerOf(Entry.getOffset());
+        if (!Exp || Exp->ExpansionBegin != Info.getExpansionLocStart())
+            return {};
+        return {Exp, -1};
+    }
+
+    const MacroExpansionNode *ExpansionLocTable::outermostExpansionOf(
+        const clang::SourceManager &SM,
+        clang::SourceLocation L) const
+    {
+        const MacroExpansionNode *Outermost = nullptr;
+        while (L.isMacroID())
+        {
+            auto Exp = originOf(SM, L).Expansion;
+            if (!Exp)
+                return nullptr;
+            Outermost = Exp;
+            L = Exp->ExpansionBegin;
+        }
+        return Outermost;
+    }
+} // namespace cpp2c
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "MacroExpansionNode.hh"
+
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+
+#include <vector>
+
+namespace cpp2c
+{
+    // A table from the source location entries the preprocessor creates
+    // for macro expansions to the expansions that created them, built while
+    // preprocessing.
+    // Clang creates an expansion's entries for its body and arguments right
+    // after the MacroExpands callback for it returns, before any other
+    // macro is expanded, so every entry created between the end of one
+    // callback and the start of the next belongs to the expansion of the
+    // former. Entries are created in order of increasing offset, so the
+    // table is sorted by offset.
+    class ExpansionLocTable
+    {
+    public:
+        // The part of a macro expansion that a location was expanded from
+        struct Origin
+        {
+            // The expansion whose body or argument the location was expanded
+            // from, or nullptr if the location is not a macro location or
+            // its origin could not be determined
+            MacroExpansionNode *Expansion = nullptr;
+            // The index of the argument of the expansion that the location
+            // was expanded from, or -1 if it was expanded from its body
+            int ArgIndex = -1;
+        };
+
+        // Call at the start of each MacroExpands callback
+        void beginExpansion(const clang::SourceManager &SM);
+        // Call at the end of each MacroExpands callback, once the given
+        // expansion's ExpansionBegin and arguments have been set
+        void endExpansion(const clang::SourceManager &SM,
+                          MacroExpansionNode *Exp);
+
+        // Returns the expansion and argument the given location was
+        // directly expanded from.
+        // Returns an empty origin for locations in entries the preprocessor
+        // creates later on while lexing an expansion, e.g., for pasted
+        // tokens.
+        Origin originOf(const clang::SourceManager &SM,
+                        clang::SourceLocation L) const;
+
+        // Returns the expansion written outside of any macro that the given
+        // location was ultimately expanded from, by following the origins
+        // of the location and of the names of the expansions it came from.
+        // Returns nullptr if the location is not a macro location or any
+        // origin along the way could not be determined.
+        const MacroExpansionNode *outermostExpansionOf(
+            const clang::SourceManager &SM,
+            clang::SourceLocation L) const;
+
+    private:
+        // A range of source location offsets whose entries were created by
+        // a single expansion
+        struct Region
+        {
+            unsigned Begin;
+            unsigned End;
+            MacroExpansionNode *Expansion;
+        };
+        std::vector<Region> Regions;
+        // Whether the last region's end is not yet known
+        bool LastRegionOpen = false;
+
+        // Returns the expansion whose region contains the given offset,
+        // if any
+        MacroExpansionNode *ownerOf(unsigned Offset) const;
+
+        // Returns the index of the argument of the given expansion whose
+        // unexpanded tokens contain the given location, or -1 if there is
+        // no such argument
+        static int argumentIndexOf(const clang::SourceManager &SM,
+                                   const MacroExpansionNode *Exp,
+                                   clang::SourceLocation L);
+    };
+} // namespace cpp2c
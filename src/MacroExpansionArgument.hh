@@ -19,6 +19,10 @@ namespace cpp2c
         // The raw tokens comprising this argument
         std::vector<clang::Token> Tokens;
         std::vector<clang::Token> TokensWithTail;
+        // The locations of the first and last tokens of this argument as
+        // written in the invocation, before any macros in it were expanded.
+        // Invalid if the argument is empty.
+        clang::SourceRange UnexpandedRange;
         // The AST roots this argument aligns with, if any
         std::vector<cpp2c::DeclStmtTypeLoc> AlignedRoots;
         // The number of times this argument is expanded in the body
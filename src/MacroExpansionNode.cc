@@ -4,7 +4,6 @@
 
 #include "assert.h"
 
-#include <queue>
 
 namespace cpp2c
 {
@@ -69,24 +68,4 @@ namespace cpp2c
             OS << "No arguments\n";
     }
 
-    std::set<MacroExpansionNode *> MacroExpansionNode::getDescendants()
-    {
-        std::set<MacroExpansionNode *> Desc;
-        // Collect descendants using BFS
-        std::queue<MacroExpansionNode *> Q;
-        for (auto &&Child : Children)
-            Q.push(Child);
-
-        while (!Q.empty())
-        {
-            auto Cur = Q.front();
-            Q.pop();
-            Desc.insert(Cur);
-            for (auto &&Child : Cur->Children)
-                Q.push(Child);
-        }
-
-        return Desc;
-    }
-
 } // namespace cpp2c
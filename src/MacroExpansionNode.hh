@@ -11,7 +11,6 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <vector>
-#include <set>
 
 namespace cpp2c
 {
@@ -21,6 +20,11 @@ namespace cpp2c
     public:
         // Info about the macro this is an expansion of
         clang::MacroInfo *MI;
+        // The latest TranslationUnitOrder key of the definition of any macro
+        // expanded under this invocation, not counting macros passed to this
+        // macro's invocation as arguments, or 0 if there are none.
+        // Set by MacroForest::aggregateDescendants.
+        unsigned LatestDescendantDefinitionKey = 0;
         // The name of the expanded macro
         llvm::StringRef Name;
         // The hash of the macro this expansion is an expansion of.
@@ -37,6 +41,10 @@ namespace cpp2c
         // The spelling range of nested expansions is inside the definition
         // of the macro whose expansion they are nested under.
         clang::SourceRange SpellingRange;
+        // The location of the name of the expanded macro in this
+        // invocation, which the source location entries of this
+        // expansion's body record as the start of their expansion
+        clang::SourceLocation ExpansionBegin;
         // How deeply nested this macro is in its expansion tree
         unsigned int Depth;
         // The expansion that this expansion was expanded under (if any)
@@ -77,11 +85,6 @@ namespace cpp2c
             llvm::raw_fd_ostream &OS,
             clang::SourceManager &SM,
             const clang::LangOptions &LO);
-
-        // Returns the set of all macros expanded under this invocation.
-        // Does not include macros passed to this macro's invocation as
-        // arguments.
-        std::set<MacroExpansionNode *> getDescendants();
     };
 
 } // namespace cpp2c
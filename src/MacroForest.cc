@@ -9,6 +9,8 @@
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+
 // TODO:    Check if we should treat expansions written in scratch space
 //          differently from other expansions
 
@@ -35,6 +37,8 @@ namespace cpp2c
         auto &SM = Ctx.getSourceManager();
         const auto &LO = Ctx.getLangOpts();
 
+        LocTable.beginExpansion(SM);
+
         // Initialize the new expansion with the parts we can get
         // directly from clang
 
@@ -49,6 +53,7 @@ namespace cpp2c
         Expansion->SpellingRange = getSpellingRange(Ctx,
                                                     Range.getBegin(),
                                                     Range.getEnd());
+        Expansion->ExpansionBegin = Range.getBegin();
         Expansion->InMacroArg = InMacroArg;
 
         // Add the expansion to the forest
@@ -114,6 +119,14 @@ namespace cpp2c
                                ? MI->params()[i]->getName()
                                : llvm::StringRef("__VA_ARGS__");
 
+                auto UnexpTokens = Args->getUnexpArgument(i);
+                auto NumUnexpTokens =
+                    clang::MacroArgs::getArgLength(UnexpTokens);
+                if (NumUnexpTokens > 0)
+                    Arg.UnexpandedRange = clang::SourceRange(
+                        UnexpTokens[0].getLocation(),
+                        UnexpTokens[NumUnexpTokens - 1].getLocation());
+
                 // Collect the argument's tokens
                 if (!ArgTokens.empty())
                 {
@@ -164,6 +177,29 @@ namespace cpp2c
             P->HasStringification |= Expansion->HasStringification;
             P->HasTokenPasting |= Expansion->HasTokenPasting;
         }
+
+        LocTable.endExpansion(SM, Expansion);
+    }
+
+    void MacroForest::aggregateDescendants(TranslationUnitOrder &Order)
+    {
+        // Expansions are created before the expansions under them, so
+        // visiting them in reverse visits each expansion only after all of
+        // its descendants have been folded into it
+        for (auto It = Expansions.rbegin(); It != Expansions.rend(); ++It)
+        {
+            auto Exp = *It;
+            auto P = Exp->Parent;
+            if (!P)
+                continue;
+            P->LatestDescendantDefinitionKey =
+                std::max(P->LatestDescendantDefinitionKey,
+                         Exp->LatestDescendantDefinitionKey);
+            auto Key = Order.keyOf(Exp->MI);
+            if (Key != TranslationUnitOrder::NoKey)
+                P->LatestDescendantDefinitionKey =
+                    std::max(P->LatestDescendantDefinitionKey, Key);
+        }
     }
 
 } // namespace cpp2c
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "ExpansionLocTable.hh"
 #include "MacroExpansionNode.hh"
+#include "TranslationUnitOrder.hh"
 
 #include "clang/Lex/PPCallbacks.h"
 #include "clang/AST/ASTContext.h"
@@ -26,11 +28,19 @@ namespace cpp2c
         // of the current invocation.
         std::stack<cpp2c::MacroExpansionNode *> InvocationStack;
 
+        // Maps the macro locations each expansion creates back to it
+        cpp2c::ExpansionLocTable LocTable;
+
         MacroForest(clang::Preprocessor &PP, clang::ASTContext &Ctx);
 
         void MacroExpands(const clang::Token &MacroNameTok,
                           const clang::MacroDefinition &MD,
                           clang::SourceRange Range,
                           const clang::MacroArgs *Args) override;
+
+        // Folds each expansion into the aggregates its ancestors keep of
+        // their descendants, ordering definitions by the given keys.
+        // Must be called once, after preprocessing has finished.
+        void aggregateDescendants(TranslationUnitOrder &Order);
     };
 } // namespace cpp2c
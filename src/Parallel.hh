@@ -0,0 +1,26 @@
+#pragma once
+
+#include "llvm/Support/ThreadPool.h"
+
+namespace cpp2c
+{
+    // Calls F once for each index in [0, N), and returns once all calls have
+    // finished. If a thread pool is given, then the calls are run on the
+    // pool's threads in no particular order; otherwise they are run on the
+    // current thread in order.
+    template <typename Fn>
+    void parallelFor(llvm::ThreadPool *Pool, unsigned N, Fn F)
+    {
+        if (!Pool)
+        {
+            for (unsigned I = 0; I < N; I++)
+                F(I);
+            return;
+        }
+
+        for (unsigned I = 0; I < N; I++)
+            Pool->async([&F, I]
+                        { F(I); });
+        Pool->wait();
+    }
+} // namespace cpp2c
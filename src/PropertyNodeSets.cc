@@ -0,0 +1,172 @@
+#include "PropertyNodeSets.hh"
+
+#include "clang/AST/RecursiveASTVisitor.h"
+
+#include <algorithm>
+
+namespace cpp2c
+{
+    // Visits the AST in the same order as a MatchFinder, adding each Stmt to
+    // the sets it belongs to
+    class PropertyNodeSetsBuilder
+        : public clang::RecursiveASTVisitor<PropertyNodeSetsBuilder>
+    {
+        using Base = clang::RecursiveASTVisitor<PropertyNodeSetsBuilder>;
+
+    public:
+        PropertyNodeSets &Sets;
+        std::function<bool(const clang::Type *)> &HasLocalType;
+
+        std::vector<char> Visited;
+        // The number of nodes requiring integral constant expressions that
+        // the traversal is currently under
+        unsigned ICEContextDepth = 0;
+
+        PropertyNodeSetsBuilder(
+            PropertyNodeSets &Sets,
+            std::function<bool(const clang::Type *)> &HasLocalType)
+            : Sets(Sets), HasLocalType(HasLocalType),
+              Visited(Sets.Numbering.size(), false) {}
+
+        bool shouldVisitTemplateInstantiations() const { return true; }
+        bool shouldVisitImplicitCode() const { return true; }
+
+        // Returns true if the subexpressions of the given Decl must be
+        // integral constant expressions
+        static bool requiresICE(const clang::Decl *D)
+        {
+            if (clang::isa<clang::EnumDecl>(D))
+                return true;
+
+            if (auto FD = clang::dyn_cast<clang::FieldDecl>(D))
+                return FD->isBitField();
+
+            if (auto VD = clang::dyn_cast<clang::VarDecl>(D))
+            {
+                auto QT = VD->getType();
+                if (!QT.isNull())
+                    if (auto T = QT.getTypePtrOrNull())
+                        return T->isArrayType();
+            }
+            return false;
+        }
+
+        // Adds the given Stmt to the sets it belongs to, and returns them
+        unsigned char collect(const clang::Stmt *S)
+        {
+            if (clang::isa<clang::ImplicitCastExpr>(S) ||
+                clang::isa<clang::ImplicitValueInitExpr>(S))
+                return 0;
+
+            auto E = clang::dyn_cast<clang::Expr>(S);
+            if (!E)
+                return 0;
+
+            unsigned char Kinds = 0;
+            if (clang::isa<clang::DeclRefExpr>(E))
+                Kinds |= PropertyNodeSets::DeclRef;
+
+            if (auto B = clang::dyn_cast<clang::BinaryOperator>(E))
+            {
+                if (B->isAssignmentOp())
+                    Kinds |= PropertyNodeSets::SideEffect;
+                else if (B->isLogicalOp())
+                    Kinds |= PropertyNodeSets::Conditional;
+            }
+            else if (auto U = clang::dyn_cast<clang::UnaryOperator>(E))
+            {
+                if (U->isIncrementDecrementOp())
+                    Kinds |= PropertyNodeSets::SideEffect;
+                else if (U->getOpcode() == clang::UO_AddrOf)
+                    Kinds |= PropertyNodeSets::AddressOf;
+            }
+            else if (clang::isa<clang::ConditionalOperator>(E))
+                Kinds |= PropertyNodeSets::Conditional;
+
+            // Only check the type if the set is collected, since this is
+            // the most expensive check
+            if ((Sets.Collected & PropertyNodeSets::LocallyTyped) &&
+                HasLocalType(E->getType().getTypePtrOrNull()))
+                Kinds |= PropertyNodeSets::LocallyTyped;
+
+            Kinds &= Sets.Collected;
+            if (Kinds & PropertyNodeSets::DeclRef)
+                Sets.AllDeclRefExprs.push_back(
+                    clang::cast<clang::DeclRefExpr>(E));
+            if (Kinds & PropertyNodeSets::SideEffect)
+                Sets.SideEffectExprs.push_back(E);
+            if (Kinds & PropertyNodeSets::AddressOf)
+                Sets.AddressOfExprs.push_back(
+                    clang::cast<clang::UnaryOperator>(E));
+            if (Kinds & PropertyNodeSets::Conditional)
+                Sets.ConditionalExprs.push_back(E);
+            if (Kinds & PropertyNodeSets::LocallyTyped)
+                Sets.ExprsWithLocallyDefinedTypes.push_back(E);
+            return Kinds;
+        }
+
+        bool TraverseStmt(clang::Stmt *S)
+        {
+            if (!S)
+                return true;
+            // Some nodes, such as the operands of both forms of an
+            // initializer list, are visited more than once; only collect
+            // them the first time
+            auto N = Sets.Numbering.numberOf(S);
+            if (N != StmtNumbering::NoNumber && !Visited[N])
+            {
+                Visited[N] = true;
+                Sets.Kinds[N] = collect(S);
+            }
+            // A Stmt visited more than once is under each of its parents
+            if (N != StmtNumbering::NoNumber && Sets.CollectedICEContexts &&
+                ICEContextDepth)
+                Sets.UnderICEContext[N] = true;
+
+            bool RequiresICE = clang::isa<clang::CaseStmt>(S);
+            ICEContextDepth += RequiresICE;
+            bool Result = Base::TraverseStmt(S);
+            ICEContextDepth -= RequiresICE;
+            return Result;
+        }
+
+        bool TraverseDecl(clang::Decl *D)
+        {
+            bool RequiresICE = D && requiresICE(D);
+            ICEContextDepth += RequiresICE;
+            bool Result = Base::TraverseDecl(D);
+            ICEContextDepth -= RequiresICE;
+            return Result;
+        }
+    };
+
+    PropertyNodeSets::PropertyNodeSets(
+        clang::ASTContext &Ctx,
+        const StmtNumbering &Numbering,
+        std::function<bool(const clang::Type *)> HasLocalType,
+        unsigned char Collect,
+        bool CollectICEContexts)
+        : Numbering(Numbering), Collected(Collect),
+          CollectedICEContexts(CollectICEContexts),
+          Kinds(Numbering.size(), 0),
+          UnderICEContext(Numbering.size(), false)
+    {
+        if (!Collect && !CollectICEContexts)
+            return;
+
+        PropertyNodeSetsBuilder Builder(*this, HasLocalType);
+        Builder.TraverseAST(Ctx);
+
+        // The traversal does not visit Stmts in the order they are numbered
+        auto ByNumber = [&Numbering](const clang::Stmt *A,
+                                     const clang::Stmt *B)
+        { return Numbering.numberOf(A) < Numbering.numberOf(B); };
+        std::sort(AllDeclRefExprs.begin(), AllDeclRefExprs.end(), ByNumber);
+        std::sort(SideEffectExprs.begin(), SideEffectExprs.end(), ByNumber);
+        std::sort(AddressOfExprs.begin(), AddressOfExprs.end(), ByNumber);
+        std::sort(ConditionalExprs.begin(), ConditionalExprs.end(), ByNumber);
+        std::sort(ExprsWithLocallyDefinedTypes.begin(),
+                  ExprsWithLocallyDefinedTypes.end(),
+                  ByNumber);
+    }
+} // namespace cpp2c
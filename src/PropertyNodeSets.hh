@@ -0,0 +1,96 @@
+#pragma once
+
+#include "StmtNumbering.hh"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/AST/Type.h"
+
+#include <functional>
+#include <vector>
+
+namespace cpp2c
+{
+    // The sets of Exprs in a translation unit that the properties of macro
+    // invocations are checked against, collected in a single traversal of
+    // the AST, along with whether each Stmt lies where an integral constant
+    // expression is required.
+    // Each set is a vector sorted by the Stmts' numbers in the given
+    // numbering.
+    // Implicit casts and implicit value initializations are not included in
+    // any set.
+    class PropertyNodeSets
+    {
+    public:
+        // Flags for the sets a Stmt belongs to
+        enum Kind : unsigned char
+        {
+            DeclRef = 1 << 0,
+            SideEffect = 1 << 1,
+            AddressOf = 1 << 2,
+            Conditional = 1 << 3,
+            LocallyTyped = 1 << 4,
+        };
+        static const constexpr unsigned char AllKinds =
+            DeclRef | SideEffect | AddressOf | Conditional | LocallyTyped;
+
+        // Any reference to a decl
+        std::vector<const clang::DeclRefExpr *> AllDeclRefExprs;
+        // Any expr with side-effects:
+        // binary assignment expressions, pre/post inc/dec
+        std::vector<const clang::Expr *> SideEffectExprs;
+        // Any expr that is an address-of expr
+        std::vector<const clang::UnaryOperator *> AddressOfExprs;
+        // Any expr with short-circuiting:
+        // ConditionalOperator, LogicalAnd, LogicalOr
+        std::vector<const clang::Expr *> ConditionalExprs;
+        // Any expr with a type defined at a local scope
+        std::vector<const clang::Expr *> ExprsWithLocallyDefinedTypes;
+
+        const StmtNumbering &Numbering;
+        // The sets that were collected
+        unsigned char Collected;
+        // Whether the Stmts under nodes requiring integral constant
+        // expressions were collected
+        bool CollectedICEContexts;
+        // The sets each Stmt belongs to, indexed by number
+        std::vector<unsigned char> Kinds;
+        // Whether each Stmt lies under a case label, an enum, a bit-field,
+        // or an array variable, indexed by number
+        std::vector<char> UnderICEContext;
+
+        // Collects the given sets for the given AST context, and whether
+        // each Stmt lies under a node requiring integral constant expressions
+        // if asked to. The AST is not traversed if nothing is collected.
+        // HasLocalType should return true if any type in the given type is
+        // a local type.
+        PropertyNodeSets(
+            clang::ASTContext &Ctx,
+            const StmtNumbering &Numbering,
+            std::function<bool(const clang::Type *)> HasLocalType,
+            unsigned char Collect = AllKinds,
+            bool CollectICEContexts = true);
+
+        // Returns the sets the given Stmt belongs to, so that properties can
+        // check the nodes under an invocation without scanning the sets
+        unsigned char kindsOf(const clang::Stmt *S) const
+        {
+            auto N = Numbering.numberOf(S);
+            return N == StmtNumbering::NoNumber ? 0 : Kinds[N];
+        }
+
+        // Returns true if the given Stmt is a descendant of a node which can
+        // only have subexpressions that are integral constant expressions
+        bool isDescendantOfStmtRequiringICE(const clang::Stmt *S) const
+        {
+            auto N = Numbering.numberOf(S);
+            return N != StmtNumbering::NoNumber && UnderICEContext[N];
+        }
+
+        // Node sets point into the AST, so they must not be copied
+        PropertyNodeSets(const PropertyNodeSets &) = delete;
+        PropertyNodeSets &operator=(const PropertyNodeSets &) = delete;
+    };
+} // namespace cpp2c
@@ -0,0 +1,101 @@
+#include "SourceLocationCache.hh"
+
+#include <utility>
+
+namespace cpp2c
+{
+    SourceLocationCache::SourceLocationCache(const clang::SourceManager &SM,
+                                             unsigned InitialSlots)
+        : SM(SM), Slots(InitialSlots) {}
+
+    SourceLocationCache::SourceLocationCache(
+        const SourceLocationCache &Shared,
+        std::mutex &SourceManagerMutex,
+        unsigned InitialSlots)
+        : SM(Shared.SM), Shared(&Shared),
+          SourceManagerMutex(&SourceManagerMutex), Slots(InitialSlots) {}
+
+    SourceLocationCache::Decomposition SourceLocationCache::decompose(
+        clang::SourceLocation L)
+    {
+        if (L.isInvalid())
+            return {};
+
+        auto Key = L.getRawEncoding();
+        auto Found = Shared ? Shared->find(Key) : nullptr;
+        if (!Found)
+            Found = find(Key);
+        if (Found)
+        {
+            Hits++;
+            return *Found;
+        }
+
+        Misses++;
+        // Keep the table at most half full so that probe sequences stay
+        // short
+        if (2 * (NumOccupied + 1) > Slots.size())
+            grow();
+        auto &S = Slots[findSlot(Key)];
+        S.Key = Key;
+        {
+            std::unique_lock<std::mutex> Lock;
+            if (SourceManagerMutex)
+                Lock = std::unique_lock<std::mutex>(*SourceManagerMutex);
+            S.Value = {SM.getSpellingLoc(L),
+                       SM.getExpansionLoc(L),
+                       SM.getFileLoc(L),
+                       SM.getImmediateMacroCallerLoc(L)};
+        }
+        NumOccupied++;
+        return S.Value;
+    }
+
+    void SourceLocationCache::prewarm(clang::SourceLocation L)
+    {
+        while (L.isValid())
+        {
+            auto D = decompose(L);
+            decompose(D.File);
+            if (!D.ImmediateMacroCaller.isMacroID())
+            {
+                decompose(D.ImmediateMacroCaller);
+                return;
+            }
+            L = D.ImmediateMacroCaller;
+        }
+    }
+
+    void SourceLocationCache::addCounts(const SourceLocationCache &Other)
+    {
+        Hits += Other.Hits;
+        Misses += Other.Misses;
+    }
+
+    unsigned SourceLocationCache::findSlot(unsigned Key) const
+    {
+        // Nearby locations have nearby encodings, so scatter them with a
+        // multiplicative hash before probing linearly
+        unsigned Mask = Slots.size() - 1;
+        unsigned I = (Key * 2654435769u) & Mask;
+        while (Slots[I].Key != 0 && Slots[I].Key != Key)
+            I = (I + 1) & Mask;
+        return I;
+    }
+
+    const SourceLocationCache::Decomposition *SourceLocationCache::find(
+        unsigned Key) const
+    {
+        auto &S = Slots[findSlot(Key)];
+        return S.Key == Key ? &S.Value : nullptr;
+    }
+
+    void SourceLocationCache::grow()
+    {
+        std::vector<Slot> Old(Slots.size() * 2);
+        std::swap(Old, Slots);
+        for (auto &&S : Old)
+            if (S.Key != 0)
+                Slots[findSlot(S.Key)] = S;
+    }
+} // namespace cpp2c
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+
+#include <mutex>
+#include <vector>
+
+namespace cpp2c
+{
+    // A cache of the locations that the alignment and bounding matchers
+    // decompose each node's begin and end locations into.
+    // The same locations are decomposed for every expansion a node is a
+    // candidate for, so each location is only decomposed once per
+    // translation unit, and looked up by its raw encoding afterwards.
+    // The cache is not thread-safe. Threads that check candidates
+    // concurrently should each use their own cache on top of a shared one
+    // that is only read while they run, and that was warmed up beforehand
+    // with the locations they are likely to look up.
+    class SourceLocationCache
+    {
+    public:
+        // The locations the matchers look up for a single location
+        struct Decomposition
+        {
+            clang::SourceLocation Spelling;
+            clang::SourceLocation Expansion;
+            clang::SourceLocation File;
+            clang::SourceLocation ImmediateMacroCaller;
+        };
+
+        const clang::SourceManager &SM;
+
+        // The number of lookups that were and were not found in the cache
+        unsigned long Hits = 0;
+        unsigned long Misses = 0;
+
+        // The table starts with the given number of slots, which must be a
+        // power of two
+        SourceLocationCache(const clang::SourceManager &SM,
+                            unsigned InitialSlots = 1024);
+
+        // Creates a cache that looks up locations in the given shared cache
+        // before its own, and decomposes the locations it misses while
+        // holding the given mutex, since SourceManager queries fill in the
+        // SourceManager's own caches
+        SourceLocationCache(const SourceLocationCache &Shared,
+                            std::mutex &SourceManagerMutex,
+                            unsigned InitialSlots = 64);
+
+        // Returns the decomposition of the given location, decomposing it
+        // if it has not been already.
+        // Invalid locations are not cached, and decompose into invalid
+        // locations.
+        Decomposition decompose(clang::SourceLocation L);
+
+        // Decomposes the given location, each location along its chain of
+        // immediate macro callers, and the file locations of all of these,
+        // which are the locations the matchers look up for a node or token
+        // beginning or ending at the given location
+        void prewarm(clang::SourceLocation L);
+
+        clang::SourceLocation getSpellingLoc(clang::SourceLocation L)
+        {
+            return decompose(L).Spelling;
+        }
+        clang::SourceLocation getExpansionLoc(clang::SourceLocation L)
+        {
+            return decompose(L).Expansion;
+        }
+        clang::SourceLocation getFileLoc(clang::SourceLocation L)
+        {
+            return decompose(L).File;
+        }
+        clang::SourceLocation getImmediateMacroCallerLoc(
+            clang::SourceLocation L)
+        {
+            return decompose(L).ImmediateMacroCaller;
+        }
+
+        // Adds the given cache's hit and miss counts to this cache's
+        void addCounts(const SourceLocationCache &Other);
+
+    private:
+        const SourceLocationCache *Shared = nullptr;
+        std::mutex *SourceManagerMutex = nullptr;
+
+        // A slot of the open-addressing table; raw encoding 0 is the
+        // invalid location, which is never cached, so it marks empty slots
+        struct Slot
+        {
+            unsigned Key = 0;
+            Decomposition Value;
+        };
+        // The table's size is always a power of two
+        std::vector<Slot> Slots;
+        unsigned NumOccupied = 0;
+
+        // Returns the index of the slot the given key is in, or of the
+        // empty slot where it should be inserted
+        unsigned findSlot(unsigned Key) const;
+        // Returns the decomposition cached in this cache's own table for
+        // the given key, or nullptr if there is none
+        const Decomposition *find(unsigned Key) const;
+        // Doubles the size of the table
+        void grow();
+    };
+} // namespace cpp2c
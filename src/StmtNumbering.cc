@@ -0,0 +1,120 @@
+#include "StmtNumbering.hh"
+
+#include "clang/AST/RecursiveASTVisitor.h"
+
+#include <queue>
+
+namespace cpp2c
+{
+    // Visits the AST in the same order as a MatchFinder, numbering the tree
+    // under each Stmt it reaches that has not been numbered yet
+    class StmtNumberingBuilder
+        : public clang::RecursiveASTVisitor<StmtNumberingBuilder>
+    {
+        using Base = clang::RecursiveASTVisitor<StmtNumberingBuilder>;
+
+    public:
+        StmtNumbering &Numbering;
+
+        StmtNumberingBuilder(StmtNumbering &Numbering)
+            : Numbering(Numbering) {}
+
+        bool shouldVisitTemplateInstantiations() const { return true; }
+        bool shouldVisitImplicitCode() const { return true; }
+
+        bool TraverseStmt(clang::Stmt *S)
+        {
+            if (!S)
+                return true;
+            if (Numbering.numberOf(S) == StmtNumbering::NoNumber)
+                Numbering.numberFrom(S);
+            return Base::TraverseStmt(S);
+        }
+    };
+
+    StmtNumbering::StmtNumbering(clang::ASTContext &Ctx)
+    {
+        StmtNumberingBuilder Builder(*this);
+        Builder.TraverseAST(Ctx);
+    }
+
+    void StmtNumbering::numberFrom(const clang::Stmt *Root)
+    {
+        // Expressions can nest deeply, so keep the path to the current Stmt
+        // on an explicit stack
+        struct Frame
+        {
+            unsigned Number;
+            clang::Stmt::const_child_iterator Next;
+            clang::Stmt::const_child_iterator End;
+        };
+        std::vector<Frame> Path;
+
+        auto Enter = [&](const clang::Stmt *S)
+        {
+            unsigned N = Stmts.size();
+            Numbers[S] = N;
+            Stmts.push_back(S);
+            SubtreeEnds.push_back(N + 1);
+            Discontiguous.push_back(false);
+            Parents.push_back(Path.empty() ? NoNumber : Path.back().Number);
+            auto Children = S->children();
+            Path.push_back({N, Children.begin(), Children.end()});
+        };
+
+        Enter(Root);
+        while (!Path.empty())
+        {
+            auto &Cur = Path.back();
+            if (Cur.Next == Cur.End)
+            {
+                SubtreeEnds[Cur.Number] = Stmts.size();
+                Path.pop_back();
+                continue;
+            }
+
+            auto Child = *Cur.Next++;
+            if (!Child)
+                continue;
+
+            auto N = numberOf(Child);
+            if (N == NoNumber)
+            {
+                Enter(Child);
+                continue;
+            }
+
+            // The child was already numbered, so it lies outside the
+            // subtrees of the Stmts on the path that were numbered after it
+            for (auto It = Path.rbegin();
+                 It != Path.rend() && It->Number > N;
+                 ++It)
+                Discontiguous[It->Number] = true;
+            OtherParents[N].push_back(Cur.Number);
+        }
+    }
+
+    bool StmtNumbering::isInTree(const clang::Stmt *Descendant,
+                                 const clang::Stmt *Root) const
+    {
+        if (Descendant && hasContiguousSubtree(Root))
+        {
+            auto D = numberOf(Descendant);
+            auto R = numberOf(Root);
+            return D != NoNumber && R <= D && D < SubtreeEnds[R];
+        }
+
+        std::queue<const clang::Stmt *> Q({Root});
+        while (!Q.empty())
+        {
+            auto Cur = Q.front();
+            Q.pop();
+            if (Descendant == Cur)
+                return true;
+            if (Cur)
+                for (auto &&Child : Cur->children())
+                    Q.push(Child);
+        }
+        return false;
+    }
+} // namespace cpp2c
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Stmt.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <vector>
+
+namespace cpp2c
+{
+    // A numbering of every Stmt in a translation unit in preorder of the
+    // trees formed by Stmt::children(), along with the end of each Stmt's
+    // subtree, so that whether one Stmt lies under another can be checked
+    // with two comparisons instead of a traversal.
+    // Stmts are numbered starting from each Stmt that a RecursiveASTVisitor
+    // reaches before any of its ancestors.
+    // A Stmt may be the child of more than one Stmt, e.g., the operands of
+    // both forms of an initializer list. It is only numbered under the
+    // first, so the subtrees of the others are not contiguous; queries about
+    // those fall back to a traversal.
+    class StmtNumbering
+    {
+    public:
+        static const constexpr unsigned NoNumber = ~0u;
+
+        StmtNumbering(clang::ASTContext &Ctx);
+
+        // Returns the number of the given Stmt, or NoNumber if it was not
+        // numbered
+        unsigned numberOf(const clang::Stmt *S) const
+        {
+            auto It = Numbers.find(S);
+            return It == Numbers.end() ? NoNumber : It->second;
+        }
+
+        // Returns the number of Stmts that were numbered
+        unsigned size() const { return Stmts.size(); }
+
+        // Returns true if every Stmt under the given Stmt was numbered
+        // within its subtree
+        bool hasContiguousSubtree(const clang::Stmt *S) const
+        {
+            auto N = numberOf(S);
+            return N != NoNumber && !Discontiguous[N];
+        }
+
+        // Returns the given Stmt and all Stmts under it, in preorder.
+        // The given Stmt must have a contiguous subtree.
+        llvm::ArrayRef<const clang::Stmt *> subtreeOf(
+            const clang::Stmt *S) const
+        {
+            auto N = numberOf(S);
+            return llvm::makeArrayRef(Stmts).slice(N, SubtreeEnds[N] - N);
+        }
+
+        // Calls F on the given Stmt and every Stmt under it.
+        // F is called in preorder if the Stmt has a contiguous subtree;
+        // otherwise the Stmts are found with a traversal, and F may be
+        // called more than once for Stmts with more than one parent.
+        template <typename Fn>
+        void forEachInTree(const clang::Stmt *Root, Fn F) const
+        {
+            if (!Root)
+                return;
+
+            if (hasContiguousSubtree(Root))
+            {
+                for (auto S : subtreeOf(Root))
+                    F(S);
+                return;
+            }
+
+            std::vector<const clang::Stmt *> Stack({Root});
+            while (!Stack.empty())
+            {
+                auto Cur = Stack.back();
+                Stack.pop_back();
+                F(Cur);
+                for (auto &&Child : Cur->children())
+                    if (Child)
+                        Stack.push_back(Child);
+            }
+        }
+
+        // Calls F on the given Stmt and every Stmt that it lies under, once
+        // each and in no particular order. Stmts with more than one parent
+        // have the Stmts above each of their parents visited.
+        template <typename Fn>
+        void forEachAncestor(const clang::Stmt *S, Fn F) const
+        {
+            if (!S)
+                return;
+
+            auto N = numberOf(S);
+            if (N == NoNumber)
+            {
+                F(S);
+                return;
+            }
+
+            llvm::SmallVector<unsigned, 16> Stack({N});
+            llvm::SmallDenseSet<unsigned, 16> Seen;
+            Seen.insert(N);
+            auto Visit = [&](unsigned P)
+            {
+                if (P != NoNumber && Seen.insert(P).second)
+                    Stack.push_back(P);
+            };
+            while (!Stack.empty())
+            {
+                auto Cur = Stack.pop_back_val();
+                F(Stmts[Cur]);
+                Visit(Parents[Cur]);
+                auto It = OtherParents.find(Cur);
+                if (It != OtherParents.end())
+                    for (auto P : It->second)
+                        Visit(P);
+            }
+        }
+
+        // Returns true if Descendant is Root or lies under it
+        bool isInTree(const clang::Stmt *Descendant,
+                      const clang::Stmt *Root) const;
+
+        // Numbers must stay fixed, so the numbering must not be copied
+        StmtNumbering(const StmtNumbering &) = delete;
+        StmtNumbering &operator=(const StmtNumbering &) = delete;
+
+    private:
+        llvm::DenseMap<const clang::Stmt *, unsigned> Numbers;
+        // The following are indexed by number
+        std::vector<const clang::Stmt *> Stmts;
+        // One past the number of the last Stmt under each Stmt
+        std::vector<unsigned> SubtreeEnds;
+        // Whether a Stmt has children that were numbered elsewhere
+        std::vector<char> Discontiguous;
+        // The number of the Stmt each Stmt was numbered under, or NoNumber
+        // if it was numbered from the AST directly
+        std::vector<unsigned> Parents;
+        // The numbers of the other Stmts that have a Stmt as a child, for
+        // the Stmts that have more than one parent
+        llvm::DenseMap<unsigned, llvm::SmallVector<unsigned, 1>> OtherParents;
+
+        // Numbers the given Stmt and all Stmts under it that have not been
+        // numbered yet
+        void numberFrom(const clang::Stmt *Root);
+
+        friend class StmtNumberingBuilder;
+    };
+} // namespace cpp2c
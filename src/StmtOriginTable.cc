@@ -0,0 +1,39 @@
+#include "StmtOriginTable.hh"
+
+namespace cpp2c
+{
+    StmtOriginTable::StmtOriginTable(
+        const StmtNumbering &Numbering,
+        const std::vector<MacroExpansionNode *> &Expansions)
+        : Numbering(Numbering), Origins(Numbering.size())
+    {
+        auto Set = [this](const clang::Stmt *S, Origin O)
+        {
+            auto N = this->Numbering.numberOf(S);
+            if (N != StmtNumbering::NoNumber)
+                Origins[N] = O;
+        };
+
+        for (auto Exp : Expansions)
+        {
+            // Record arguments first, so that the body does not claim the
+            // Stmts expanded from them
+            for (int I = 0; I < (int)Exp->Arguments.size(); I++)
+                for (auto &&Root : Exp->Arguments[I].AlignedRoots)
+                    Numbering.forEachInTree(
+                        Root.ST,
+                        [&](const clang::Stmt *S)
+                        { Set(S, {Exp, I}); });
+
+            if (!Exp->AlignedRoot)
+                continue;
+            Numbering.forEachInTree(
+                Exp->AlignedRoot->ST,
+                [&](const clang::Stmt *S)
+                {
+                    if (!isExpandedFromAnyArgument(S, Exp))
+                        Set(S, {Exp, -1});
+                });
+        }
+    }
+} // namespace cpp2c
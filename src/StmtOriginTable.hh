@@ -0,0 +1,71 @@
+#pragma once
+
+#include "MacroExpansionNode.hh"
+#include "StmtNumbering.hh"
+
+#include "clang/AST/Stmt.h"
+
+#include <vector>
+
+namespace cpp2c
+{
+    // A table of the part of a top-level macro invocation that each Stmt in
+    // a translation unit was expanded from, indexed by Stmt number.
+    // The Stmts expanded from an invocation's body are those under its
+    // aligned root that were not expanded from one of its arguments; the
+    // Stmts expanded from an argument are those under the argument's
+    // aligned roots.
+    // Top-level invocations do not overlap, so each Stmt was expanded from
+    // at most one of them.
+    class StmtOriginTable
+    {
+    public:
+        // The part of an invocation that a Stmt was expanded from
+        struct Origin
+        {
+            // The invocation the Stmt was expanded from, or nullptr if it
+            // was not expanded from any top-level invocation
+            const MacroExpansionNode *Expansion = nullptr;
+            // The index of the argument of the invocation that the Stmt was
+            // expanded from, or -1 if it was expanded from its body
+            int ArgIndex = -1;
+        };
+
+        // Builds the table for the given top-level invocations once their
+        // bodies and arguments have been aligned with the AST
+        StmtOriginTable(const StmtNumbering &Numbering,
+                        const std::vector<MacroExpansionNode *> &Expansions);
+
+        Origin originOf(const clang::Stmt *S) const
+        {
+            auto N = Numbering.numberOf(S);
+            return N == StmtNumbering::NoNumber ? Origin() : Origins[N];
+        }
+
+        bool isExpandedFromBody(const clang::Stmt *S,
+                                const MacroExpansionNode *Exp) const
+        {
+            auto O = originOf(S);
+            return O.Expansion == Exp && O.ArgIndex == -1;
+        }
+
+        bool isExpandedFromAnyArgument(const clang::Stmt *S,
+                                       const MacroExpansionNode *Exp) const
+        {
+            auto O = originOf(S);
+            return O.Expansion == Exp && O.ArgIndex != -1;
+        }
+
+        bool isExpandedFromArgument(const clang::Stmt *S,
+                                    const MacroExpansionNode *Exp,
+                                    int ArgIndex) const
+        {
+            auto O = originOf(S);
+            return O.Expansion == Exp && O.ArgIndex == ArgIndex;
+        }
+
+    private:
+        const StmtNumbering &Numbering;
+        std::vector<Origin> Origins;
+    };
+} // namespace cpp2c
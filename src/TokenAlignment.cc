@@ -0,0 +1,86 @@
+#include "TokenAlignment.hh"
+#include "AlignmentMatchers.hh"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <utility>
+
+namespace cpp2c
+{
+    void findAlignedASTNodesForExpansionsByTokens(
+        std::vector<cpp2c::MacroExpansionNode *> &Expansions,
+        cpp2c::AlignmentContext &Context,
+        const cpp2c::ASTNodeIndex &Index,
+        const clang::syntax::TokenBuffer &Tokens)
+    {
+        auto &Ctx = Context.Ctx;
+        auto Expanded = Tokens.expandedTokens();
+
+        // Every token the parser saw has its own location, so map each
+        // location to the token's index in the expanded token stream
+        llvm::DenseMap<unsigned, unsigned> ExpandedIndex;
+        for (unsigned I = 0; I < Expanded.size(); I++)
+            ExpandedIndex.try_emplace(Expanded[I].location().getRawEncoding(),
+                                      I);
+
+        // Map the span of expanded tokens of each expansion to that
+        // expansion
+        llvm::DenseMap<std::pair<unsigned, unsigned>, unsigned> ExpansionAt;
+        for (unsigned I = 0; I < Expansions.size(); I++)
+        {
+            auto Exp = Expansions[I];
+            auto Spelled = Tokens.spelledTokenAt(Exp->SpellingRange.getBegin());
+            if (!Spelled)
+                continue;
+            // Expansions in preprocessor directives have no mapping, and
+            // empty expansions have no tokens to align with
+            auto Mapping = Tokens.expansionStartingAt(Spelled);
+            if (!Mapping || Mapping->Expanded.empty())
+                continue;
+            unsigned First = Mapping->Expanded.begin() - Expanded.begin();
+            unsigned Last = Mapping->Expanded.end() - Expanded.begin() - 1;
+            ExpansionAt.try_emplace({First, Last}, I);
+        }
+
+        // Find each node whose span of expanded tokens is exactly that of
+        // an expansion.
+        // Going through the tables in this order adds the candidates of
+        // each expansion in the order the matchers would find them.
+        std::vector<std::vector<const ASTNodeIndex::Entry *>>
+            Candidates(Expansions.size());
+        auto AddCandidates = [&](const ASTNodeIndex::NodeTable &Table)
+        {
+            for (auto &&E : Table.Entries)
+            {
+                auto Node = E.Node;
+                auto R = Node.getSourceRange();
+                auto B = ExpandedIndex.find(R.getBegin().getRawEncoding());
+                auto End = ExpandedIndex.find(R.getEnd().getRawEncoding());
+                if (B == ExpandedIndex.end() || End == ExpandedIndex.end())
+                    continue;
+
+                auto It = ExpansionAt.find({B->second, End->second});
+                if (It != ExpansionAt.end())
+                    Candidates[It->second].push_back(&E);
+            }
+        };
+        AddCandidates(Index.Stmts);
+        AddCandidates(Index.Decls);
+        AddCandidates(Index.TypeLocs);
+
+        for (unsigned I = 0; I < Expansions.size(); I++)
+        {
+            auto Exp = Expansions[I];
+            for (auto E : Candidates[I])
+                if (claimAlignedNode(E->Node, &Ctx,
+                                     Context.claimedBy(E->Node)))
+                    Exp->ASTRoots.push_back(E->Node);
+
+            // If the expansion only aligns with one node, then set this
+            // as its aligned root
+            Exp->AlignedRoot = (Exp->ASTRoots.size() == 1)
+                                   ? (&(Exp->ASTRoots.front()))
+                                   : nullptr;
+        }
+    }
+} // namespace cpp2c
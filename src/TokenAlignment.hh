@@ -0,0 +1,28 @@
+#pragma once
+
+#include "AlignmentContext.hh"
+#include "ASTNodeIndex.hh"
+#include "MacroExpansionNode.hh"
+
+#include "clang/Tooling/Syntax/Tokens.h"
+
+#include <vector>
+
+namespace cpp2c
+{
+    // Finds the AST nodes aligned with the bodies of each of the given
+    // top-level expansions using the token buffer's mapping from each
+    // expansion to the tokens it expanded to.
+    // A node aligns with an expansion if its first and last tokens are the
+    // first and last tokens the expansion expanded to.
+    // Nodes are claimed in the same order as by
+    // findAlignedASTNodesForExpansions, so only the outermost nodes are
+    // aligned.
+    // Expansions must be given in the order they were expanded.
+    // The index must outlive the expansions' ASTRoots.
+    void findAlignedASTNodesForExpansionsByTokens(
+        std::vector<cpp2c::MacroExpansionNode *> &Expansions,
+        cpp2c::AlignmentContext &Context,
+        const cpp2c::ASTNodeIndex &Index,
+        const clang::syntax::TokenBuffer &Tokens);
+} // namespace cpp2c
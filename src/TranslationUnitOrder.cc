@@ -0,0 +1,61 @@
+#include "TranslationUnitOrder.hh"
+
+#include <algorithm>
+
+namespace cpp2c
+{
+    TranslationUnitOrder::TranslationUnitOrder(
+        clang::SourceManager &SM,
+        const std::vector<std::pair<std::string,
+                                    const clang::MacroDirective *>>
+            &Definitions)
+        : SM(SM)
+    {
+        for (auto &&Entry : Definitions)
+        {
+            auto MD = Entry.second;
+            if (!MD || !MD->getMacroInfo())
+                continue;
+            auto L = SM.getFileLoc(MD->getDefinition().getLocation());
+            if (L.isInvalid())
+                continue;
+            DefinitionKeys[MD->getMacroInfo()] = 2 * DefinitionLocs.size() + 1;
+            DefinitionLocs.push_back(L);
+        }
+    }
+
+    unsigned TranslationUnitOrder::keyOf(const clang::MacroInfo *MI)
+    {
+        if (!MI)
+            return NoKey;
+        auto It = DefinitionKeys.find(MI);
+        if (It != DefinitionKeys.end())
+            return It->second;
+        // Builtin macros are not defined by a directive
+        return keyOf(MI->getDefinitionLoc());
+    }
+
+    unsigned TranslationUnitOrder::keyOf(clang::SourceLocation L)
+    {
+        L = SM.getFileLoc(L);
+        if (L.isInvalid())
+            return NoKey;
+
+        auto It = LocationKeys.find(L.getRawEncoding());
+        if (It != LocationKeys.end())
+            return It->second;
+
+        // Count the macro definitions before this location
+        auto Next = std::partition_point(
+            DefinitionLocs.begin(),
+            DefinitionLocs.end(),
+            [this, L](clang::SourceLocation Def)
+            { return SM.isBeforeInTranslationUnit(Def, L); });
+        unsigned K = Next - DefinitionLocs.begin();
+        unsigned Key = (Next != DefinitionLocs.end() && *Next == L)
+                           ? 2 * K + 1
+                           : 2 * K;
+        LocationKeys[L.getRawEncoding()] = Key;
+        return Key;
+    }
+} // namespace cpp2c
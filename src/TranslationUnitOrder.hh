@@ -0,0 +1,60 @@
+#pragma once
+
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/MacroInfo.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cpp2c
+{
+    // Integer keys ordering macro definitions, and the other locations that
+    // are compared against them, in a translation unit, so that checking
+    // whether something was defined after a macro is an integer comparison
+    // instead of a call to SourceManager::isBeforeInTranslationUnit.
+    // The preprocessor defines macros in translation unit order, so the i-th
+    // macro definition gets key 2i + 1, and any other location gets key 2k,
+    // where k is the number of macro definitions before it. Keys are exact
+    // relative to macro definitions, but locations between the same two
+    // definitions get the same key.
+    class TranslationUnitOrder
+    {
+    public:
+        static const constexpr unsigned NoKey = ~0u;
+
+        // Definitions must be in the order the preprocessor defined them
+        TranslationUnitOrder(
+            clang::SourceManager &SM,
+            const std::vector<std::pair<std::string,
+                                        const clang::MacroDirective *>>
+                &Definitions);
+
+        // Returns the key of the given macro's definition, or NoKey if its
+        // location is invalid
+        unsigned keyOf(const clang::MacroInfo *MI);
+
+        // Returns the key of the file location of the given location, or
+        // NoKey if it is invalid.
+        // Keys are memoized, so calls must be serialized.
+        unsigned keyOf(clang::SourceLocation L);
+
+        // Returns true if the location with key A comes before the location
+        // with key B
+        static bool isBefore(unsigned A, unsigned B)
+        {
+            return A != NoKey && B != NoKey && A < B;
+        }
+
+    private:
+        clang::SourceManager &SM;
+        // The file locations of the macro definitions, in order
+        std::vector<clang::SourceLocation> DefinitionLocs;
+        llvm::DenseMap<const clang::MacroInfo *, unsigned> DefinitionKeys;
+        // Keys of other locations, by raw encoding of their file location
+        llvm::DenseMap<unsigned, unsigned> LocationKeys;
+    };
+} // namespace cpp2c
@@ -0,0 +1,54 @@
+#include "TypeFactsTable.hh"
+
+namespace cpp2c
+{
+    // Returns the declaration of the given typedef, tag, or elaborated type
+    static const clang::Decl *getTypeDeclOrNull(const clang::Type *T)
+    {
+        if (!T)
+            return nullptr;
+
+        if (auto TD = clang::dyn_cast<clang::TypedefType>(T))
+            return TD->getDecl();
+        else if (auto TD = clang::dyn_cast<clang::TagType>(T))
+            return TD->getDecl();
+        else if (auto ET = clang::dyn_cast<clang::ElaboratedType>(T))
+            return getTypeDeclOrNull(ET->desugar().getTypePtrOrNull());
+        else
+            return nullptr;
+    }
+
+    TypeFactsTable::Facts TypeFactsTable::factsOf(const clang::Type *T)
+    {
+        if (!T)
+            return Facts();
+
+        auto It = Memo.find(T);
+        if (It != Memo.end())
+        {
+            Hits++;
+            return It->second;
+        }
+        Misses++;
+
+        // Peel off pointer and array layers
+        auto Inner = T;
+        while (Inner && (Inner->isAnyPointerType() || Inner->isArrayType()))
+            if (Inner->isAnyPointerType())
+                Inner = Inner->getPointeeType().getTypePtrOrNull();
+            else if (Inner->isArrayType())
+                Inner = Inner->getBaseElementTypeUnsafe();
+
+        Facts F;
+        if (auto D = getTypeDeclOrNull(Inner))
+        {
+            F.IsLocal = !D->getDeclContext()->isTranslationUnit();
+            if (auto ND = clang::dyn_cast<clang::NamedDecl>(D))
+                F.IsAnonymous =
+                    ND->getIdentifier() == nullptr || ND->getName().empty();
+            F.DefinitionKey = Order.keyOf(D->getLocation());
+        }
+        Memo[T] = F;
+        return F;
+    }
+} // namespace cpp2c
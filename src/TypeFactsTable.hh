@@ -0,0 +1,44 @@
+#pragma once
+
+#include "TranslationUnitOrder.hh"
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Type.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+namespace cpp2c
+{
+    // A memo of the facts the type properties check about the declaration
+    // of the type under any pointer and array layers of a type.
+    // Facts are keyed by the Type node itself rather than by its canonical
+    // type, since the declaration of a typedef is part of the facts.
+    // The table is not thread-safe; lookups must be serialized.
+    class TypeFactsTable
+    {
+    public:
+        struct Facts
+        {
+            // Whether the type was declared in a local scope
+            bool IsLocal = false;
+            // Whether the type was declared without a name
+            bool IsAnonymous = false;
+            // The translation unit order key of the type's declaration
+            unsigned DefinitionKey = TranslationUnitOrder::NoKey;
+        };
+
+        // The number of lookups that were and were not found in the memo
+        unsigned long Hits = 0;
+        unsigned long Misses = 0;
+
+        TypeFactsTable(TranslationUnitOrder &Order) : Order(Order) {}
+
+        // Returns the facts about the given type, finding them if they
+        // have not been already
+        Facts factsOf(const clang::Type *T);
+
+    private:
+        TranslationUnitOrder &Order;
+        llvm::DenseMap<const clang::Type *, Facts> Memo;
+    };
+} // namespace cpp2c
@@ -0,0 +1,18 @@
+#include "TypeStringCache.hh"
+
+namespace cpp2c
+{
+    llvm::StringRef TypeStringCache::canonicalStringOf(clang::QualType QT)
+    {
+        auto Canonical = QT.getDesugaredType(Ctx)
+                             .getUnqualifiedType()
+                             .getCanonicalType();
+        auto It = Strings.find(Canonical.getAsOpaquePtr());
+        if (It != Strings.end())
+            return It->second;
+
+        auto S = Saver.save(Canonical.getAsString());
+        Strings[Canonical.getAsOpaquePtr()] = S;
+        return S;
+    }
+} // namespace cpp2c
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Type.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+
+namespace cpp2c
+{
+    // Interned strings of the canonical types that type signatures are
+    // built from.
+    // Printing a type is slow, and signatures are made of the same few
+    // types, so each canonical type is only printed once per translation
+    // unit.
+    // The cache is not thread-safe; lookups must be serialized.
+    class TypeStringCache
+    {
+    public:
+        TypeStringCache(clang::ASTContext &Ctx)
+            : Ctx(Ctx), Saver(Allocator) {}
+
+        // Returns the string of the desugared, unqualified, canonical form
+        // of the given type
+        llvm::StringRef canonicalStringOf(clang::QualType QT);
+
+    private:
+        clang::ASTContext &Ctx;
+        llvm::BumpPtrAllocator Allocator;
+        llvm::UniqueStringSaver Saver;
+        // Strings by the opaque pointer of their canonical type
+        llvm::DenseMap<void *, llvm::StringRef> Strings;
+    };
+} // namespace cpp2c
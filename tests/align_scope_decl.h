@@ -0,0 +1,3 @@
+    x = ID(x);
+
+// Expected invocation properties are listed in align_scope_decl.c